@@ -21,6 +21,11 @@
 #define DECLARE_PARENTHESIZED(...)  (__VA_ARGS__),
 #define DECLARE_STRING(SYMBOL, ...) #SYMBOL __VA_OPT__(,) __VA_ARGS__,
 
+// For X macros whose first argument is a name and the rest are attributes of
+// it, like FOREACH_MY_STATE(X) with X(STATE, PARENT):
+#define DECLARE_FIRST(FIRST, ...)        FIRST,
+#define DECLARE_FIRST_STRING(FIRST, ...) #FIRST,
+
 #define M_CONCAT(A, B)  M_CONCAT_(A, B)
 
 #define M_INVOKE(F, ...) F(__VA_ARGS__)
@@ -33,14 +38,22 @@
 // parens would break the generated code. For example, the if the X macro
 // arguments are struct field initializers, the parens would prevent declaring
 // arrays of such structs.
-#define M_NUM_DECLS_IN( FOREACH_X_MACRO        ) M_NUM_DECLS_IN_(FOREACH_X_MACRO(DECLARE_PARENTHESIZED))
+//
+// M_NUM_DECLS_IN() and M_LAST_DECL_IN() work with up to 8192 declarations, and
+// cost time in proportion to the number of declarations, not to that limit:
+// M_NUM_DECLS_IN() is the length of a string literal with a character per
+// declaration, so it suits constant expressions but not #if or token pasting,
+// and M_LAST_DECL_IN() looks for the last declaration a chunk at a time.
+// M_SELECT_DECL()'s offset must be under 256, but the X macro may be longer.
+// `make xmacro_compile_bench` times them from 256 to 4096 declarations.
+#define M_NUM_DECLS_IN( FOREACH_X_MACRO        ) ((int)sizeof("" FOREACH_X_MACRO(M_ONE_CHAR_)) - 1)
 #define M_SELECT_DECL(  offset, FOREACH_X_MACRO) M_PEEL(M_INVOKE(M_CONCAT_(M_GET_ARG_, offset), FOREACH_X_MACRO(DECLARE_PARENTHESIZED)))
 #define M_FIRST_DECL_IN(FOREACH_X_MACRO        ) M_SELECT_DECL(0,                                                             FOREACH_X_MACRO)
-#define M_LAST_DECL_IN( FOREACH_X_MACRO        ) M_SELECT_DECL(M_OFFSET_OF_LAST_ARG_(FOREACH_X_MACRO(DECLARE_PARENTHESIZED)), FOREACH_X_MACRO)
+#define M_LAST_DECL_IN( FOREACH_X_MACRO        ) M_PEEL(M_LAST_DECL_(FOREACH_X_MACRO(DECLARE_PARENTHESIZED)))
 
 #define M_SELECT_ARG(offset, ...) M_INVOKE(M_CONCAT_(M_GET_ARG_, offset), __VA_ARGS__)
 
-#define M_NUM_ARGS(...) M_NUM_DECLS_IN_(__VA_OPT__(A,) __VA_ARGS__)
+#define M_NUM_ARGS(...) M_NUM_DECLS_IN_(__VA_OPT__(A,) __VA_ARGS__) // Up to 256 arguments
 
 ////////////////////////////////////////////////////////////////////////////////
 // Internals
@@ -49,19 +62,21 @@
 
 #define M_PEEL_(...) __VA_ARGS__
 
-// These two macros shift the integers over by the number of elements in
-// __VA_ARGS__, then select the 256th integer from the start. One tricksy bit
-// is that FOREACH_X_MACRO(DECLARE_NAME) includes an empty "extra" argument due
-// to the trailing comma after the last name, so the integer lists start with
-// 255 and 254 instead of the 256 and 255 that might seem intuitively correct.
+#define M_ONE_CHAR_(...) "x"
+
+// M_NUM_DECLS_IN_(), for M_NUM_ARGS(), shifts the integers over by the number
+// of elements in __VA_ARGS__, then selects the 256th integer from the start.
+// One tricksy bit is that FOREACH_X_MACRO(DECLARE_NAME) includes an empty
+// "extra" argument due to the trailing comma after the last name, so the
+// integer list starts with 255 instead of the 256 that might seem intuitively
+// correct.
 //
 // So, if __VA_ARGS__ has one "real" element (plus the empty extra one), the
-// integers will shift over by two places, and M_NUM_DECLS_IN_() will return "1",
-// while M_OFFSET_OF_LAST_ARG_() will return "0". These can then be concantenated
-// with "M_GET_ARG_" to dispatch into the helper macros below to retrieve
-// the appropriate arg.
-#define M_NUM_DECLS_IN_(...)       M_GET_ARG_256(__VA_ARGS__, 255, 254, 253, 252, 251, 250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 240, 239, 238, 237, 236, 235, 234, 233, 232, 231, 230, 229, 228, 227, 226, 225, 224, 223, 222, 221, 220, 219, 218, 217, 216, 215, 214, 213, 212, 211, 210, 209, 208, 207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197, 196, 195, 194, 193, 192, 191, 190, 189, 188, 187, 186, 185, 184, 183, 182, 181, 180, 179, 178, 177, 176, 175, 174, 173, 172, 171, 170, 169, 168, 167, 166, 165, 164, 163, 162, 161, 160, 159, 158, 157, 156, 155, 154, 153, 152, 151, 150, 149, 148, 147, 146, 145, 144, 143, 142, 141, 140, 139, 138, 137, 136, 135, 134, 133, 132, 131, 130, 129, 128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113, 112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100, 99, 98, 97, 96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, 80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
-#define M_OFFSET_OF_LAST_ARG_(...) M_GET_ARG_256(__VA_ARGS__,      254, 253, 252, 251, 250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 240, 239, 238, 237, 236, 235, 234, 233, 232, 231, 230, 229, 228, 227, 226, 225, 224, 223, 222, 221, 220, 219, 218, 217, 216, 215, 214, 213, 212, 211, 210, 209, 208, 207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197, 196, 195, 194, 193, 192, 191, 190, 189, 188, 187, 186, 185, 184, 183, 182, 181, 180, 179, 178, 177, 176, 175, 174, 173, 172, 171, 170, 169, 168, 167, 166, 165, 164, 163, 162, 161, 160, 159, 158, 157, 156, 155, 154, 153, 152, 151, 150, 149, 148, 147, 146, 145, 144, 143, 142, 141, 140, 139, 138, 137, 136, 135, 134, 133, 132, 131, 130, 129, 128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113, 112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100, 99, 98, 97, 96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, 80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+// integers will shift over by two places, and M_NUM_DECLS_IN_() will return
+// "1". M_OFFSET_OF_LAST_IN_CHUNK_() below works the same way, returning "0"
+// for that list, which can then be concantenated with "M_GET_ARG_" to
+// dispatch into the helper macros below to retrieve the appropriate arg.
+#define M_NUM_DECLS_IN_(...) M_GET_ARG_256(__VA_ARGS__, 255, 254, 253, 252, 251, 250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 240, 239, 238, 237, 236, 235, 234, 233, 232, 231, 230, 229, 228, 227, 226, 225, 224, 223, 222, 221, 220, 219, 218, 217, 216, 215, 214, 213, 212, 211, 210, 209, 208, 207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197, 196, 195, 194, 193, 192, 191, 190, 189, 188, 187, 186, 185, 184, 183, 182, 181, 180, 179, 178, 177, 176, 175, 174, 173, 172, 171, 170, 169, 168, 167, 166, 165, 164, 163, 162, 161, 160, 159, 158, 157, 156, 155, 154, 153, 152, 151, 150, 149, 148, 147, 146, 145, 144, 143, 142, 141, 140, 139, 138, 137, 136, 135, 134, 133, 132, 131, 130, 129, 128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113, 112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100, 99, 98, 97, 96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, 80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
 
 #define M_GET_ARG_0(  _0, ...) _0
 #define M_GET_ARG_1(  _0, _1, ...) _1
@@ -321,3 +336,102 @@
 #define M_GET_ARG_255(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, _65, _66, _67, _68, _69, _70, _71, _72, _73, _74, _75, _76, _77, _78, _79, _80, _81, _82, _83, _84, _85, _86, _87, _88, _89, _90, _91, _92, _93, _94, _95, _96, _97, _98, _99, _100, _101, _102, _103, _104, _105, _106, _107, _108, _109, _110, _111, _112, _113, _114, _115, _116, _117, _118, _119, _120, _121, _122, _123, _124, _125, _126, _127, _128, _129, _130, _131, _132, _133, _134, _135, _136, _137, _138, _139, _140, _141, _142, _143, _144, _145, _146, _147, _148, _149, _150, _151, _152, _153, _154, _155, _156, _157, _158, _159, _160, _161, _162, _163, _164, _165, _166, _167, _168, _169, _170, _171, _172, _173, _174, _175, _176, _177, _178, _179, _180, _181, _182, _183, _184, _185, _186, _187, _188, _189, _190, _191, _192, _193, _194, _195, _196, _197, _198, _199, _200, _201, _202, _203, _204, _205, _206, _207, _208, _209, _210, _211, _212, _213, _214, _215, _216, _217, _218, _219, _220, _221, _222, _223, _224, _225, _226, _227, _228, _229, _230, _231, _232, _233, _234, _235, _236, _237, _238, _239, _240, _241, _242, _243, _244, _245, _246, _247, _248, _249, _250, _251, _252, _253, _254, _255, ...) _255
 #define M_GET_ARG_256(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, _65, _66, _67, _68, _69, _70, _71, _72, _73, _74, _75, _76, _77, _78, _79, _80, _81, _82, _83, _84, _85, _86, _87, _88, _89, _90, _91, _92, _93, _94, _95, _96, _97, _98, _99, _100, _101, _102, _103, _104, _105, _106, _107, _108, _109, _110, _111, _112, _113, _114, _115, _116, _117, _118, _119, _120, _121, _122, _123, _124, _125, _126, _127, _128, _129, _130, _131, _132, _133, _134, _135, _136, _137, _138, _139, _140, _141, _142, _143, _144, _145, _146, _147, _148, _149, _150, _151, _152, _153, _154, _155, _156, _157, _158, _159, _160, _161, _162, _163, _164, _165, _166, _167, _168, _169, _170, _171, _172, _173, _174, _175, _176, _177, _178, _179, _180, _181, _182, _183, _184, _185, _186, _187, _188, _189, _190, _191, _192, _193, _194, _195, _196, _197, _198, _199, _200, _201, _202, _203, _204, _205, _206, _207, _208, _209, _210, _211, _212, _213, _214, _215, _216, _217, _218, _219, _220, _221, _222, _223, _224, _225, _226, _227, _228, _229, _230, _231, _232, _233, _234, _235, _236, _237, _238, _239, _240, _241, _242, _243, _244, _245, _246, _247, _248, _249, _250, _251, _252, _253, _254, _255, _256, ...) _256
 
+
+// M_LAST_DECL_IN() takes a list of parenthesized declarations with the same
+// empty extra argument at the end. If there are at most 64 declarations, it
+// selects the last one with M_OFFSET_OF_LAST_IN_CHUNK_(). Longer lists are
+// whittled down in chunks, each step checking whether more than a chunk's
+// worth are left and, if so, dropping that many and passing the rest on to
+// the next step: 512 at a time while more than 512 are left, then 64 at a
+// time. Every step re-reads the list, so the chunks are large enough to keep
+// the steps few. Lists longer than 8192 don't compile.
+#define M_LAST_DECL_(...)       M_CONCAT(M_LAST_DECL_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_0           M_LAST_IN_CHUNK_
+#define M_LAST_DECL_1           M_LAST_DECL_BIG0_
+
+#define M_LAST_IN_CHUNK_(...)   M_INVOKE(M_CONCAT(M_GET_ARG_, M_OFFSET_OF_LAST_IN_CHUNK_(__VA_ARGS__)), __VA_ARGS__)
+#define M_OFFSET_OF_LAST_IN_CHUNK_(...) M_GET_ARG_65(__VA_ARGS__, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define M_MORE_THAN_64_(...)    M_IS_NOT_EMPTY_I_(M_GET_ARG_64(__VA_ARGS__ ,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,))
+#define M_MORE_THAN_512_(...)   M_IS_NOT_EMPTY_I_(M_ARG_512_(__VA_ARGS__ ,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,))
+#define M_IS_NOT_EMPTY_I_(...)  M_IS_NOT_EMPTY_(__VA_ARGS__)
+#define M_IS_NOT_EMPTY_(...)    M_GET_ARG_0(__VA_OPT__(1,) 0)
+
+#define M_LAST_DECL_BIG0_(...)  M_CONCAT(M_LAST_DECL_BIG0_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG0_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG0_1(...)  M_LAST_DECL_BIG1_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG1_(...)  M_CONCAT(M_LAST_DECL_BIG1_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG1_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG1_1(...)  M_LAST_DECL_BIG2_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG2_(...)  M_CONCAT(M_LAST_DECL_BIG2_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG2_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG2_1(...)  M_LAST_DECL_BIG3_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG3_(...)  M_CONCAT(M_LAST_DECL_BIG3_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG3_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG3_1(...)  M_LAST_DECL_BIG4_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG4_(...)  M_CONCAT(M_LAST_DECL_BIG4_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG4_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG4_1(...)  M_LAST_DECL_BIG5_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG5_(...)  M_CONCAT(M_LAST_DECL_BIG5_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG5_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG5_1(...)  M_LAST_DECL_BIG6_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG6_(...)  M_CONCAT(M_LAST_DECL_BIG6_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG6_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG6_1(...)  M_LAST_DECL_BIG7_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG7_(...)  M_CONCAT(M_LAST_DECL_BIG7_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG7_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG7_1(...)  M_LAST_DECL_BIG8_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG8_(...)  M_CONCAT(M_LAST_DECL_BIG8_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG8_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG8_1(...)  M_LAST_DECL_BIG9_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG9_(...)  M_CONCAT(M_LAST_DECL_BIG9_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG9_0  M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG9_1(...)  M_LAST_DECL_BIG10_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG10_(...) M_CONCAT(M_LAST_DECL_BIG10_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG10_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG10_1(...) M_LAST_DECL_BIG11_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG11_(...) M_CONCAT(M_LAST_DECL_BIG11_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG11_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG11_1(...) M_LAST_DECL_BIG12_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG12_(...) M_CONCAT(M_LAST_DECL_BIG12_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG12_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG12_1(...) M_LAST_DECL_BIG13_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG13_(...) M_CONCAT(M_LAST_DECL_BIG13_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG13_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG13_1(...) M_LAST_DECL_BIG14_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG14_(...) M_CONCAT(M_LAST_DECL_BIG14_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG14_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG14_1(...) M_LAST_DECL_BIG15_(M_DROP_512_(__VA_ARGS__))
+#define M_LAST_DECL_BIG15_(...) M_CONCAT(M_LAST_DECL_BIG15_, M_MORE_THAN_512_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_BIG15_0 M_LAST_DECL_L0_
+#define M_LAST_DECL_BIG15_1(...) M_LAST_DECL_BIG16_(M_DROP_512_(__VA_ARGS__))
+
+#define M_LAST_DECL_L0_(...) M_CONCAT(M_LAST_DECL_L0_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L0_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L0_1(...) M_LAST_DECL_L1_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L1_(...) M_CONCAT(M_LAST_DECL_L1_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L1_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L1_1(...) M_LAST_DECL_L2_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L2_(...) M_CONCAT(M_LAST_DECL_L2_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L2_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L2_1(...) M_LAST_DECL_L3_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L3_(...) M_CONCAT(M_LAST_DECL_L3_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L3_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L3_1(...) M_LAST_DECL_L4_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L4_(...) M_CONCAT(M_LAST_DECL_L4_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L4_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L4_1(...) M_LAST_DECL_L5_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L5_(...) M_CONCAT(M_LAST_DECL_L5_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L5_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L5_1(...) M_LAST_DECL_L6_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L6_(...) M_CONCAT(M_LAST_DECL_L6_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L6_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L6_1(...) M_LAST_DECL_L7_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L7_(...) M_CONCAT(M_LAST_DECL_L7_, M_MORE_THAN_64_(__VA_ARGS__))(__VA_ARGS__)
+#define M_LAST_DECL_L7_0 M_LAST_IN_CHUNK_
+#define M_LAST_DECL_L7_1(...) M_LAST_DECL_L8_(M_DROP_64_(__VA_ARGS__))
+#define M_LAST_DECL_L8_ M_LAST_IN_CHUNK_ // At most 64 are left after 7 drops
+
+#define M_DROP_64_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, ...) __VA_ARGS__
+#define M_DROP_512_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, _65, _66, _67, _68, _69, _70, _71, _72, _73, _74, _75, _76, _77, _78, _79, _80, _81, _82, _83, _84, _85, _86, _87, _88, _89, _90, _91, _92, _93, _94, _95, _96, _97, _98, _99, _100, _101, _102, _103, _104, _105, _106, _107, _108, _109, _110, _111, _112, _113, _114, _115, _116, _117, _118, _119, _120, _121, _122, _123, _124, _125, _126, _127, _128, _129, _130, _131, _132, _133, _134, _135, _136, _137, _138, _139, _140, _141, _142, _143, _144, _145, _146, _147, _148, _149, _150, _151, _152, _153, _154, _155, _156, _157, _158, _159, _160, _161, _162, _163, _164, _165, _166, _167, _168, _169, _170, _171, _172, _173, _174, _175, _176, _177, _178, _179, _180, _181, _182, _183, _184, _185, _186, _187, _188, _189, _190, _191, _192, _193, _194, _195, _196, _197, _198, _199, _200, _201, _202, _203, _204, _205, _206, _207, _208, _209, _210, _211, _212, _213, _214, _215, _216, _217, _218, _219, _220, _221, _222, _223, _224, _225, _226, _227, _228, _229, _230, _231, _232, _233, _234, _235, _236, _237, _238, _239, _240, _241, _242, _243, _244, _245, _246, _247, _248, _249, _250, _251, _252, _253, _254, _255, _256, _257, _258, _259, _260, _261, _262, _263, _264, _265, _266, _267, _268, _269, _270, _271, _272, _273, _274, _275, _276, _277, _278, _279, _280, _281, _282, _283, _284, _285, _286, _287, _288, _289, _290, _291, _292, _293, _294, _295, _296, _297, _298, _299, _300, _301, _302, _303, _304, _305, _306, _307, _308, _309, _310, _311, _312, _313, _314, _315, _316, _317, _318, _319, _320, _321, _322, _323, _324, _325, _326, _327, _328, _329, _330, _331, _332, _333, _334, _335, _336, _337, _338, _339, _340, _341, _342, _343, _344, _345, _346, _347, _348, _349, _350, _351, _352, _353, _354, _355, _356, _357, _358, _359, _360, _361, _362, _363, _364, _365, _366, _367, _368, _369, _370, _371, _372, _373, _374, _375, _376, _377, _378, _379, _380, _381, _382, _383, _384, _385, _386, _387, _388, _389, _390, _391, _392, _393, _394, _395, _396, _397, _398, _399, _400, _401, _402, _403, _404, _405, _406, _407, _408, _409, _410, _411, _412, _413, _414, _415, _416, _417, _418, _419, _420, _421, _422, _423, _424, _425, _426, _427, _428, _429, _430, _431, _432, _433, _434, _435, _436, _437, _438, _439, _440, _441, _442, _443, _444, _445, _446, _447, _448, _449, _450, _451, _452, _453, _454, _455, _456, _457, _458, _459, _460, _461, _462, _463, _464, _465, _466, _467, _468, _469, _470, _471, _472, _473, _474, _475, _476, _477, _478, _479, _480, _481, _482, _483, _484, _485, _486, _487, _488, _489, _490, _491, _492, _493, _494, _495, _496, _497, _498, _499, _500, _501, _502, _503, _504, _505, _506, _507, _508, _509, _510, _511, ...) __VA_ARGS__
+#define M_ARG_512_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, _65, _66, _67, _68, _69, _70, _71, _72, _73, _74, _75, _76, _77, _78, _79, _80, _81, _82, _83, _84, _85, _86, _87, _88, _89, _90, _91, _92, _93, _94, _95, _96, _97, _98, _99, _100, _101, _102, _103, _104, _105, _106, _107, _108, _109, _110, _111, _112, _113, _114, _115, _116, _117, _118, _119, _120, _121, _122, _123, _124, _125, _126, _127, _128, _129, _130, _131, _132, _133, _134, _135, _136, _137, _138, _139, _140, _141, _142, _143, _144, _145, _146, _147, _148, _149, _150, _151, _152, _153, _154, _155, _156, _157, _158, _159, _160, _161, _162, _163, _164, _165, _166, _167, _168, _169, _170, _171, _172, _173, _174, _175, _176, _177, _178, _179, _180, _181, _182, _183, _184, _185, _186, _187, _188, _189, _190, _191, _192, _193, _194, _195, _196, _197, _198, _199, _200, _201, _202, _203, _204, _205, _206, _207, _208, _209, _210, _211, _212, _213, _214, _215, _216, _217, _218, _219, _220, _221, _222, _223, _224, _225, _226, _227, _228, _229, _230, _231, _232, _233, _234, _235, _236, _237, _238, _239, _240, _241, _242, _243, _244, _245, _246, _247, _248, _249, _250, _251, _252, _253, _254, _255, _256, _257, _258, _259, _260, _261, _262, _263, _264, _265, _266, _267, _268, _269, _270, _271, _272, _273, _274, _275, _276, _277, _278, _279, _280, _281, _282, _283, _284, _285, _286, _287, _288, _289, _290, _291, _292, _293, _294, _295, _296, _297, _298, _299, _300, _301, _302, _303, _304, _305, _306, _307, _308, _309, _310, _311, _312, _313, _314, _315, _316, _317, _318, _319, _320, _321, _322, _323, _324, _325, _326, _327, _328, _329, _330, _331, _332, _333, _334, _335, _336, _337, _338, _339, _340, _341, _342, _343, _344, _345, _346, _347, _348, _349, _350, _351, _352, _353, _354, _355, _356, _357, _358, _359, _360, _361, _362, _363, _364, _365, _366, _367, _368, _369, _370, _371, _372, _373, _374, _375, _376, _377, _378, _379, _380, _381, _382, _383, _384, _385, _386, _387, _388, _389, _390, _391, _392, _393, _394, _395, _396, _397, _398, _399, _400, _401, _402, _403, _404, _405, _406, _407, _408, _409, _410, _411, _412, _413, _414, _415, _416, _417, _418, _419, _420, _421, _422, _423, _424, _425, _426, _427, _428, _429, _430, _431, _432, _433, _434, _435, _436, _437, _438, _439, _440, _441, _442, _443, _444, _445, _446, _447, _448, _449, _450, _451, _452, _453, _454, _455, _456, _457, _458, _459, _460, _461, _462, _463, _464, _465, _466, _467, _468, _469, _470, _471, _472, _473, _474, _475, _476, _477, _478, _479, _480, _481, _482, _483, _484, _485, _486, _487, _488, _489, _490, _491, _492, _493, _494, _495, _496, _497, _498, _499, _500, _501, _502, _503, _504, _505, _506, _507, _508, _509, _510, _511, _512, ...) _512
@@ -0,0 +1,91 @@
+#include "psm_clock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Measures each psm_clock.h backend's cost per read, the largest step seen
+// between successive distinct readings (its effective resolution), and how
+// far it drifts from std::chrono::steady_clock over a sampling window, next
+// to the cost of reading the per-tick cached value machines actually use.
+//
+// Usage: clock_bench [num_reads [window_ms]]
+
+static volatile uint64_t cached_now_ms; // Stands in for the mocks' now_ms
+
+template <typename F>
+static double ns_per_call(size_t num_calls, F&& f) {
+    uint64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_calls; ++i) {
+        sum += f();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    asm volatile("" : : "r"(sum));
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_calls;
+}
+
+template <typename clock_t>
+static void measure(const char *name, clock_t& clock, size_t num_reads, uint64_t window_ms) {
+    const double ns = ns_per_call(num_reads, [&] { return clock.read_ms(); });
+
+    // Spin for the window, tracking the largest step and the drift against
+    // steady_clock.
+    const psm_steady_clock_t steady;
+    const uint64_t steady_start = steady.read_ms();
+    const uint64_t clock_start  = clock.read_ms();
+    uint64_t prev     = clock_start;
+    uint64_t max_step = 0;
+    int64_t  max_skew = 0;
+    while (steady.read_ms() - steady_start < window_ms) {
+        const uint64_t now = clock.read_ms();
+        if (now != prev) {
+            max_step = std::max(max_step, now - prev);
+            prev     = now;
+        }
+        const int64_t skew = (int64_t)(now - clock_start) - (int64_t)(steady.read_ms() - steady_start);
+        max_skew = std::abs(skew) > std::abs(max_skew) ? skew : max_skew;
+    }
+    const int64_t end_skew = (int64_t)(clock.read_ms() - clock_start) - (int64_t)(steady.read_ms() - steady_start);
+
+    std::cout
+        << std::left << std::setw(22) << name
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ns << " ns/read"
+        << std::setw(6) << max_step << " ms step"
+        << std::setw(6) << max_skew << " ms max skew"
+        << std::setw(6) << end_skew << " ms end skew\n";
+}
+
+int main(int argc, char **argv) {
+    const size_t   num_reads = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000000;
+    const uint64_t window_ms = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1000;
+
+    std::cout << num_reads << " reads per clock, skew against steady_clock over " << window_ms << " ms\n";
+
+    std::cout
+        << std::left << std::setw(22) << "cached per tick"
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << ns_per_call(num_reads, [] { return cached_now_ms; }) << " ns/read\n";
+
+    psm_steady_clock_t steady;
+    measure("psm_steady_clock_t", steady, num_reads, window_ms);
+
+    psm_coarse_clock_t coarse;
+    measure("psm_coarse_clock_t", coarse, num_reads, window_ms);
+
+#if PSM_HAVE_TSC_CLOCK
+    psm_tsc_clock_t tsc;
+    measure("psm_tsc_clock_t", tsc, num_reads, window_ms);
+    std::cout << "TSC " << (psm_tsc_clock_t::is_invariant() ? "is" : "is NOT") << " invariant\n";
+#endif
+
+    psm_virtual_clock_t virtual_clock;
+    std::cout
+        << std::left << std::setw(22) << "psm_virtual_clock_t"
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << ns_per_call(num_reads, [&] { asm volatile("" : : "r"(&virtual_clock) : "memory"); return virtual_clock.read_ms(); }) << " ns/read (doesn't run on its own)\n";
+
+    return EXIT_SUCCESS;
+}
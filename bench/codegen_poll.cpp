@@ -0,0 +1,9 @@
+#include "stoplight_sm.h"
+
+// A stoplight_sm_t::poll() with external linkage, for `make codegen_test` to
+// disassemble. Built once with psm_machine_t::do_actions() and once with
+// -DSTOPLIGHT_USE_PSM_DO_ACTIONS to compare the two engines' code.
+
+extern "C" ms_t codegen_poll(stoplight_sm_t& sm) {
+    return sm.poll();
+}
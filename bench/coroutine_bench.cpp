@@ -0,0 +1,283 @@
+#include "psm_coroutine.h"
+#include "psm_inputs.h"
+#include "psm_machine.h"
+
+#include "X_macro_helpers.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Compares the CPU time of polling idle-heavy machines every tick against
+// running the same machines as psm_co_machine_t coroutines, which are resumed
+// only when a deadline they await arrives or an input they watch changes.
+//
+// Each machine cycles Red, Green and Yellow with a dwell of 2 to 5 s, and
+// every machine flashes while a shared fault input is set, so nearly every
+// tick finds nearly every machine with nothing to do. Flashing's exit is
+// rejected until it has flashed for min_flash_ms, well after the fault
+// clears, so the comparison covers cancelled transitions too. Both forms must
+// end with the same states, the same number of state entries and the same
+// machines having had an exit rejected, and a machine started past the
+// executor's capacity must be refused.
+//
+// Usage: coroutine_bench [num_machines [num_ticks]]
+
+#define FOREACH_LAMP_STATE(X) \
+    X(Red)                    \
+    X(Green)                  \
+    X(Yellow)                 \
+    X(Flashing)               \
+
+static size_t now_ms;
+
+static constexpr size_t min_flash_ms = 2000;
+
+enum class lamp_state_t : PSM_STATE_INDEX_TYPE(FOREACH_LAMP_STATE) {
+    unset,
+    FOREACH_LAMP_STATE(DECLARE_NAME)
+};
+
+// Read by both forms, which the coroutines wait on
+static psm_input_t<bool> fault;
+
+////////////////////////////////////////////////////////////////////////////////
+// Polled every tick
+
+class polled_lamp_t : public psm_machine_t<polled_lamp_t> {
+public:
+    explicit polled_lamp_t(size_t dwell_ms_) : dwell_ms(dwell_ms_) {}
+
+    void poll() {
+        do_actions();
+    }
+
+    size_t num_entries   = 0;
+    bool   exit_rejected = false;
+
+    using state_t = lamp_state_t;
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+private:
+    friend psm_machine_t;
+
+    void actions(PSM_ACTIONS_PARAMS) {
+        IF_ENTRY {
+            state_entered_ms = now_ms;
+            ++num_entries;
+        }
+        IF_DO {
+            if (fault) { next_state = state_t::Flashing; }
+        }
+
+        switch (state) {
+            case state_t::unset:
+                next_state = state_t::Red;
+                break;
+
+            case state_t::Red:
+                IF_DO {
+                    if (now_ms - state_entered_ms > dwell_ms) { next_state = state_t::Green; }
+                }
+                break;
+
+            case state_t::Green:
+                IF_DO {
+                    if (now_ms - state_entered_ms > dwell_ms) { next_state = state_t::Yellow; }
+                }
+                break;
+
+            case state_t::Yellow:
+                IF_DO {
+                    if (now_ms - state_entered_ms > 1000) { next_state = state_t::Red; }
+                }
+                break;
+
+            case state_t::Flashing:
+                IF_DO {
+                    if (!fault) { next_state = state_t::Red; }
+                }
+                IF_EXIT {
+                    if (now_ms - state_entered_ms < min_flash_ms) {
+                        next_state    = state;
+                        exit_rejected = true;
+                    }
+                }
+                break;
+        }
+    }
+
+    size_t state_entered_ms = 0;
+    size_t dwell_ms;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Resumed only when ready
+
+class co_lamp_t : public psm_co_machine_t<co_lamp_t> {
+public:
+    co_lamp_t(executor_t& executor, const psm_input_t<bool>& fault_, size_t dwell_ms_)
+        : psm_co_machine_t(executor)
+        , fault(fault_)
+        , dwell_ms(dwell_ms_)
+    {}
+
+    size_t num_entries   = 0;
+    bool   exit_rejected = false;
+
+    using state_t = lamp_state_t;
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+private:
+    friend psm_co_machine_t;
+
+    psm_task_t actions(PSM_CO_ACTIONS_PARAMS) {
+        PSM_CO_PASSES {
+            IF_ENTRY {
+                state_entered_ms = now_ms;
+                ++num_entries;
+            }
+            IF_DO {
+                if (fault.get()) { next_state = state_t::Flashing; }
+            }
+
+            switch (state) {
+                case state_t::unset:
+                    next_state = state_t::Red;
+                    break;
+
+                case state_t::Red:
+                    IF_DO {
+                        if (now_ms - state_entered_ms > dwell_ms) { next_state = state_t::Green; }
+                        else { co_await wait_until(state_entered_ms + dwell_ms + 1, fault); }
+                    }
+                    break;
+
+                case state_t::Green:
+                    IF_DO {
+                        if (now_ms - state_entered_ms > dwell_ms) { next_state = state_t::Yellow; }
+                        else { co_await wait_until(state_entered_ms + dwell_ms + 1, fault); }
+                    }
+                    break;
+
+                case state_t::Yellow:
+                    IF_DO {
+                        if (now_ms - state_entered_ms > 1000) { next_state = state_t::Red; }
+                        else { co_await wait_until(state_entered_ms + 1001, fault); }
+                    }
+                    break;
+
+                case state_t::Flashing:
+                    IF_DO {
+                        if (!fault.get()) { next_state = state_t::Red; }
+                        else { co_await wait_for(fault); }
+                    }
+                    IF_EXIT {
+                        if (now_ms - state_entered_ms < min_flash_ms) {
+                            next_state    = state;
+                            exit_rejected = true;
+                            co_await wait_until(state_entered_ms + min_flash_ms, fault);
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+
+    const psm_input_t<bool>& fault;
+    size_t                   state_entered_ms = 0;
+    size_t                   dwell_ms;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename F>
+static double cpu_seconds_to_run(F&& f) {
+    const std::clock_t start = std::clock();
+    f();
+    return double(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *name, size_t num_machine_ticks, double seconds) {
+    std::cout
+        << std::left << std::setw(28) << name
+        << std::right << std::setw(10) << std::fixed << std::setprecision(3) << seconds << " s CPU"
+        << std::setw(10) << std::setprecision(2) << seconds * 1e9 / num_machine_ticks << " ns/machine/tick\n";
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 10000;
+
+    const size_t fault_ms       = num_ticks * 2 / 5;
+    const size_t fault_clear_ms = fault_ms + 500;
+
+    auto dwell_ms = [] (size_t i) { return 2000 + i % 3000; };
+
+    std::vector<polled_lamp_t> polled;
+    polled.reserve(num_machines);
+    for (size_t i = 0; i < num_machines; ++i) {
+        polled.emplace_back(dwell_ms(i));
+    }
+
+    now_ms = 0;
+    fault.set(false);
+    const double polled_s = cpu_seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            fault.set(now_ms >= fault_ms && now_ms < fault_clear_ms);
+            for (auto& sm : polled) {
+                sm.poll();
+            }
+        }
+    });
+
+    psm_executor_t<size_t> executor(num_machines, 0);
+    std::vector<std::unique_ptr<co_lamp_t>> co;
+    co.reserve(num_machines);
+    for (size_t i = 0; i < num_machines; ++i) {
+        co.push_back(std::make_unique<co_lamp_t>(executor, fault, dwell_ms(i)));
+        if (!co.back()->start()) {
+            std::cerr << "coroutine_bench: executor full at machine " << i << "\n";
+            return 1;
+        }
+    }
+
+    co_lamp_t one_too_many(executor, fault, dwell_ms(0));
+    const bool refused = !one_too_many.start(); // The executor only has room for num_machines
+
+    now_ms = 0;
+    const double co_s = cpu_seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            fault.set(now_ms >= fault_ms && now_ms < fault_clear_ms);
+            executor.run(now_ms);
+        }
+    });
+
+    size_t mismatches    = 0;
+    size_t num_entries   = 0;
+    size_t num_rejecting = 0;
+    for (size_t i = 0; i < num_machines; ++i) {
+        mismatches += polled[i].state         != co[i]->state
+                   || polled[i].num_entries   != co[i]->num_entries
+                   || polled[i].exit_rejected != co[i]->exit_rejected;
+        num_entries   += polled[i].num_entries;
+        num_rejecting += polled[i].exit_rejected;
+    }
+
+    std::cout
+        << num_machines << " idle-heavy machines x " << num_ticks << " ticks, " << num_entries << " state entries, "
+        << num_rejecting << " with an exit rejected\n";
+    report("polled every tick",   num_machines * num_ticks, polled_s);
+    report("psm_co_machine_t",    num_machines * num_ticks, co_s);
+    std::cout << (mismatches ? "FINAL STATES DIFFER\n" : "final states match\n");
+    std::cout << (refused ? "machine past executor capacity refused\n" : "MACHINE PAST EXECUTOR CAPACITY ACCEPTED\n");
+
+    std::cout << (num_rejecting ? "rejected exits compared\n" : "NO EXIT WAS REJECTED\n");
+
+    return mismatches || !refused || !num_rejecting ? 1 : 0;
+}
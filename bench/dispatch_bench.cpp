@@ -0,0 +1,129 @@
+#include "stoplight_sm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Polls an array of stoplight_sm_t objects every tick, for comparing builds
+// with and without profile-guided dispatch hints (see psm_dispatch.h and
+// `make dispatch_bench`, which runs this under perf stat where there is one).
+//
+// Usage: dispatch_bench [-p profile_file] [num_machines [num_ticks]]
+//
+// A warmup staggers the machines across the Red/Green/Yellow cycle, so
+// neighbouring machines are in different states and the dispatch isn't
+// trivially predictable. Then every 1000 ticks one machine in a hundred gets
+// an error event, cleared 500 ticks later. Built with -DSTOPLIGHT_PROFILE,
+// -p writes the dispatch profile of the whole run to profile_file for
+// dispatch_gen.
+//
+// The digest at the end depends only on how the machines behaved, so it must
+// be the same for every build.
+
+static constexpr size_t CYCLE_MS = 5001 + 5001 + 1001 + 3; // Red, Green, Yellow and a tick per entry
+static constexpr size_t ROUND_MS = 1000;
+
+static int usage() {
+    std::cerr << "usage: dispatch_bench [-p profile_file] [num_machines [num_ticks]]\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *profile_file = nullptr;
+    size_t      num_machines = 10000;
+    size_t      num_ticks    = 20000;
+
+    for (int i = 1, positional = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        }
+        else if (argv[i][0] != '-' && positional == 0) {
+            num_machines = strtoul(argv[i], nullptr, 0);
+            ++positional;
+        }
+        else if (argv[i][0] != '-' && positional == 1) {
+            num_ticks = strtoul(argv[i], nullptr, 0);
+            ++positional;
+        }
+        else {
+            return usage();
+        }
+    }
+#ifndef STOPLIGHT_PROFILE
+    if (profile_file) {
+        std::cerr << "dispatch_bench: -p needs a build with -DSTOPLIGHT_PROFILE\n";
+        return 1;
+    }
+#endif
+
+    log_enabled = false;
+
+    std::vector<stoplight_sm_t> machines(num_machines);
+
+    // Warmup: hold every machine in Errored, then release each at a different
+    // point in the cycle.
+    for (now_ms = 0; now_ms < CYCLE_MS; ++now_ms) {
+        for (size_t i = 0; i < num_machines; ++i) {
+            if (now_ms == 0) {
+                machines[i].handle_error_event();
+            }
+            else if (now_ms == 1 + i * 7919 % (CYCLE_MS - 1)) {
+                machines[i].handle_error_cleared_event();
+            }
+            machines[i].poll();
+        }
+    }
+
+    // Timed in rounds of ROUND_MS ticks, each with the same events, so the
+    // fastest round shows the cost with the least interference from whatever
+    // else the machine is running.
+    const size_t end_ms    = now_ms + num_ticks;
+    double       seconds   = 0;
+    double       fastest_s = 0;
+    while (now_ms < end_ms) {
+        const size_t round_ms     = std::min(ROUND_MS, end_ms - now_ms);
+        const size_t round_end_ms = now_ms + round_ms;
+        const auto   start        = std::chrono::steady_clock::now();
+        for (; now_ms < round_end_ms; ++now_ms) {
+            if (now_ms % 1000 == 0  ) { for (size_t i = now_ms / 1000 % 100; i < num_machines; i += 100) machines[i].handle_error_event();         }
+            if (now_ms % 1000 == 500) { for (size_t i = now_ms / 1000 % 100; i < num_machines; i += 100) machines[i].handle_error_cleared_event(); }
+            for (auto& sm : machines) {
+                sm.poll();
+            }
+        }
+        const double round_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        seconds += round_s;
+        if (round_ms == ROUND_MS && (fastest_s == 0 || round_s < fastest_s)) {
+            fastest_s = round_s;
+        }
+    }
+
+    size_t digest = 0;
+    for (size_t i = 0; i < num_machines; ++i) {
+        digest = digest * 1000003 + machines[i].elapsed_ms();
+    }
+
+#ifdef STOPLIGHT_PROFILE
+    if (profile_file) {
+        std::ofstream out(profile_file);
+        stoplight_sm_t::export_dispatch_profile(out);
+        if (!out) {
+            perror(profile_file);
+            return 1;
+        }
+    }
+#endif
+
+    std::cout
+        << num_machines << " machines x " << num_ticks << " ticks: "
+        << std::fixed << std::setprecision(2) << seconds * 1e9 / ((double)num_machines * num_ticks) << " ns/poll, "
+        << "fastest round " << fastest_s * 1e9 / ((double)num_machines * ROUND_MS) << " ns/poll, "
+        << "digest " << std::hex << digest << std::dec << "\n";
+
+    return 0;
+}
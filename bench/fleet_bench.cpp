@@ -0,0 +1,102 @@
+#include "psm_fleet.h"
+#include "stoplight_sm.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Compares polling an array of stoplight_sm_t objects against polling the
+// same number of machines held in a psm_fleet_t.
+//
+// Throughput is per member covered, every member every tick, followed by the
+// number of polls actually made. The array polls every member; the fleet's
+// guard pre-pass skips members with nothing to do, so it makes far fewer.
+//
+// Usage: fleet_bench [num_machines [num_ticks]]
+
+template <typename F>
+static double seconds_to_run(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void report(const char *name, size_t num_covered, size_t num_polls, double seconds) {
+    std::cout
+        << std::left << std::setw(28) << name
+        << std::right << std::setw(14) << (size_t)(num_covered / seconds) << " members/s"
+        << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1e9 / num_covered << " ns/member"
+        << std::setw(14) << num_polls << " polls made"
+        << std::setw(9) << 100.0 * num_polls / num_covered << "%\n";
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 10000;
+    const size_t num_covered  = num_machines * num_ticks;
+
+    // An error event partway through each run so both forms take the same
+    // Errored detour as well as cycling Red/Green/Yellow.
+    const size_t error_ms = num_ticks / 2;
+    const size_t cleared_ms = error_ms + 1000;
+
+    log_enabled = false;
+
+    std::vector<stoplight_sm_t> objects(num_machines);
+    now_ms = 0;
+    const double objects_s = seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            if (now_ms == error_ms  ) { for (auto& sm : objects) sm.handle_error_event();         }
+            if (now_ms == cleared_ms) { for (auto& sm : objects) sm.handle_error_cleared_event(); }
+            for (auto& sm : objects) {
+                sm.poll();
+            }
+        }
+    });
+
+    psm_fleet_t<stoplight_sm_t> fleet(num_machines);
+    size_t                      fleet_polls = 0;
+    now_ms = 0;
+    const double fleet_s = seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            if (now_ms == error_ms  ) { for (size_t i = 0; i < num_machines; ++i) fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event();         }); }
+            if (now_ms == cleared_ms) { for (size_t i = 0; i < num_machines; ++i) fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); }); }
+            fleet_polls += fleet.poll();
+        }
+    });
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_machines; ++i) {
+        fleet.visit(i, [&] (stoplight_sm_t& sm) {
+            mismatches += !(sm == objects[i]);
+        });
+    }
+
+    // A fleet made when   now_ms   is in the second half of its 2^32 ms cycle,
+    // where a zero deadline reads as one still in the future, must start its
+    // members all the same.
+    now_ms = 0x80000000;
+    psm_fleet_t<stoplight_sm_t> late(64);
+    stoplight_sm_t              late_object;
+    for (const ms_t end_ms = now_ms + 20000; now_ms < end_ms; ++now_ms) {
+        late.poll();
+        late_object.poll();
+    }
+    size_t late_mismatches = 0;
+    for (size_t i = 0; i < late.size(); ++i) {
+        late.visit(i, [&] (stoplight_sm_t& sm) {
+            late_mismatches += !(sm == late_object);
+        });
+    }
+
+    std::cout << num_machines << " machines x " << num_ticks << " ticks, single core\n";
+    report("stoplight_sm_t[]",             num_covered, num_covered, objects_s);
+    report("psm_fleet_t<stoplight_sm_t>",  num_covered, fleet_polls, fleet_s);
+    std::cout << "final states " << (mismatches ? "DIFFER" : "match") << "\n";
+    std::cout << "fleet made at now_ms 0x80000000: " << (late_mismatches ? "DIFFERS" : "matches") << "\n";
+
+    return mismatches || late_mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
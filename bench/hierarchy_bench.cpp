@@ -0,0 +1,335 @@
+#include "polling_state_machine.h"
+#include "psm_hierarchy.h"
+#include "psm_table.h"
+
+#include "X_macro_helpers.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <type_traits>
+
+// Compares a flat 64-state machine dispatched through PSM_DECLARE_HANDLER_TABLE()
+// against the same 64 states nested three deep under 20 parent states and
+// dispatched through PSM_DECLARE_HIERARCHICAL_HANDLER_TABLE(): once with
+// parents that have no actions, which should cost the same as flat, and once
+// with entry, do and exit actions on every parent.
+//
+// Every leaf state dwells one to three polls, then moves to a scattered
+// successor, so most transitions leave and enter several parents.
+//
+// Usage: hierarchy_bench [num_polls]
+
+#define FOREACH_LEAF_STATE(X) \
+    X(S000) \
+    X(S001) \
+    X(S002) \
+    X(S003) \
+    X(S010) \
+    X(S011) \
+    X(S012) \
+    X(S013) \
+    X(S020) \
+    X(S021) \
+    X(S022) \
+    X(S023) \
+    X(S030) \
+    X(S031) \
+    X(S032) \
+    X(S033) \
+    X(S100) \
+    X(S101) \
+    X(S102) \
+    X(S103) \
+    X(S110) \
+    X(S111) \
+    X(S112) \
+    X(S113) \
+    X(S120) \
+    X(S121) \
+    X(S122) \
+    X(S123) \
+    X(S130) \
+    X(S131) \
+    X(S132) \
+    X(S133) \
+    X(S200) \
+    X(S201) \
+    X(S202) \
+    X(S203) \
+    X(S210) \
+    X(S211) \
+    X(S212) \
+    X(S213) \
+    X(S220) \
+    X(S221) \
+    X(S222) \
+    X(S223) \
+    X(S230) \
+    X(S231) \
+    X(S232) \
+    X(S233) \
+    X(S300) \
+    X(S301) \
+    X(S302) \
+    X(S303) \
+    X(S310) \
+    X(S311) \
+    X(S312) \
+    X(S313) \
+    X(S320) \
+    X(S321) \
+    X(S322) \
+    X(S323) \
+    X(S330) \
+    X(S331) \
+    X(S332) \
+    X(S333) \
+
+#define FOREACH_NESTED_STATE(X) \
+    X(G0,   unset) \
+    X(G00,  G0   ) \
+    X(S000, G00  ) \
+    X(S001, G00  ) \
+    X(S002, G00  ) \
+    X(S003, G00  ) \
+    X(G01,  G0   ) \
+    X(S010, G01  ) \
+    X(S011, G01  ) \
+    X(S012, G01  ) \
+    X(S013, G01  ) \
+    X(G02,  G0   ) \
+    X(S020, G02  ) \
+    X(S021, G02  ) \
+    X(S022, G02  ) \
+    X(S023, G02  ) \
+    X(G03,  G0   ) \
+    X(S030, G03  ) \
+    X(S031, G03  ) \
+    X(S032, G03  ) \
+    X(S033, G03  ) \
+    X(G1,   unset) \
+    X(G10,  G1   ) \
+    X(S100, G10  ) \
+    X(S101, G10  ) \
+    X(S102, G10  ) \
+    X(S103, G10  ) \
+    X(G11,  G1   ) \
+    X(S110, G11  ) \
+    X(S111, G11  ) \
+    X(S112, G11  ) \
+    X(S113, G11  ) \
+    X(G12,  G1   ) \
+    X(S120, G12  ) \
+    X(S121, G12  ) \
+    X(S122, G12  ) \
+    X(S123, G12  ) \
+    X(G13,  G1   ) \
+    X(S130, G13  ) \
+    X(S131, G13  ) \
+    X(S132, G13  ) \
+    X(S133, G13  ) \
+    X(G2,   unset) \
+    X(G20,  G2   ) \
+    X(S200, G20  ) \
+    X(S201, G20  ) \
+    X(S202, G20  ) \
+    X(S203, G20  ) \
+    X(G21,  G2   ) \
+    X(S210, G21  ) \
+    X(S211, G21  ) \
+    X(S212, G21  ) \
+    X(S213, G21  ) \
+    X(G22,  G2   ) \
+    X(S220, G22  ) \
+    X(S221, G22  ) \
+    X(S222, G22  ) \
+    X(S223, G22  ) \
+    X(G23,  G2   ) \
+    X(S230, G23  ) \
+    X(S231, G23  ) \
+    X(S232, G23  ) \
+    X(S233, G23  ) \
+    X(G3,   unset) \
+    X(G30,  G3   ) \
+    X(S300, G30  ) \
+    X(S301, G30  ) \
+    X(S302, G30  ) \
+    X(S303, G30  ) \
+    X(G31,  G3   ) \
+    X(S310, G31  ) \
+    X(S311, G31  ) \
+    X(S312, G31  ) \
+    X(S313, G31  ) \
+    X(G32,  G3   ) \
+    X(S320, G32  ) \
+    X(S321, G32  ) \
+    X(S322, G32  ) \
+    X(S323, G32  ) \
+    X(G33,  G3   ) \
+    X(S330, G33  ) \
+    X(S331, G33  ) \
+    X(S332, G33  ) \
+    X(S333, G33  ) \
+
+#define FOREACH_PARENT_STATE(X) \
+    X(G0) \
+    X(G1) \
+    X(G2) \
+    X(G3) \
+    X(G00) \
+    X(G01) \
+    X(G02) \
+    X(G03) \
+    X(G10) \
+    X(G11) \
+    X(G12) \
+    X(G13) \
+    X(G20) \
+    X(G21) \
+    X(G22) \
+    X(G23) \
+    X(G30) \
+    X(G31) \
+    X(G32) \
+    X(G33) \
+
+constexpr int num_leaf_states = M_NUM_DECLS_IN(FOREACH_LEAF_STATE);
+
+#define LEAF_NUMBER(STATE) STATE##_n,
+enum { FOREACH_LEAF_STATE(LEAF_NUMBER) };
+
+// The leaf actions both forms share, so they differ only in dispatch and in
+// the parents' actions.
+
+template <typename sm_t>
+inline void leaf_entry(sm_t& sm, int) {
+    ++sm.entries;
+}
+
+template <typename sm_t>
+inline void leaf_do(sm_t& sm, int leaf) {
+    if (++sm.polls_in_state > (unsigned)(leaf % 3)) {
+        sm.next_state = sm_t::leaf_states[(leaf * 37 + 11) % num_leaf_states];
+    }
+}
+
+template <typename sm_t>
+inline void leaf_exit(sm_t& sm, int) {
+    sm.polls_in_state = 0;
+}
+
+#define LEAF_STATE(STATE) state_t::STATE,
+
+#define LEAF_STATE_STRUCT(STATE)                                                        \
+    struct STATE {                                                                      \
+        static void entry     (bench_sm_t& sm) { leaf_entry(sm, STATE##_n); }           \
+        static void do_actions(bench_sm_t& sm) { leaf_do   (sm, STATE##_n); }           \
+        static void exit      (bench_sm_t& sm) { leaf_exit (sm, STATE##_n); }           \
+    };                                                                                  \
+
+struct flat_sm_t {
+    using bench_sm_t = flat_sm_t;
+
+    enum class state_t { unset, FOREACH_LEAF_STATE(DECLARE_NAME) };
+
+    static constexpr state_t leaf_states[] = { FOREACH_LEAF_STATE(LEAF_STATE) };
+
+    struct unset {
+        static void do_actions(flat_sm_t& sm) { sm.next_state = leaf_states[0]; }
+    };
+
+    FOREACH_LEAF_STATE(LEAF_STATE_STRUCT)
+
+    PSM_DECLARE_HANDLER_TABLE(flat_sm_t, FOREACH_LEAF_STATE)
+
+    void poll() {
+        psm_do_table_actions(*this, handler_table);
+    }
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    unsigned polls_in_state = 0;
+    unsigned entries        = 0;
+    unsigned parent_actions = 0;
+};
+
+#define IDLE_PARENT_STRUCT(STATE) struct STATE {};
+
+#define ACTING_PARENT_STRUCT(STATE)                                                     \
+    struct STATE {                                                                      \
+        template <typename sm_t> static void entry     (sm_t& sm) { ++sm.parent_actions; } \
+        template <typename sm_t> static void do_actions(sm_t& sm) { ++sm.parent_actions; } \
+        template <typename sm_t> static void exit      (sm_t& sm) { ++sm.parent_actions; } \
+    };                                                                                  \
+
+struct idle_parents_t   { FOREACH_PARENT_STATE(IDLE_PARENT_STRUCT)   };
+struct acting_parents_t { FOREACH_PARENT_STATE(ACTING_PARENT_STRUCT) };
+
+template <typename parents_t>
+struct nested_sm_t {
+    using bench_sm_t = nested_sm_t;
+
+    enum class state_t { unset, FOREACH_NESTED_STATE(DECLARE_FIRST) };
+
+    static constexpr state_t leaf_states[] = { FOREACH_LEAF_STATE(LEAF_STATE) };
+
+    struct unset {
+        static void do_actions(nested_sm_t& sm) { sm.next_state = leaf_states[0]; }
+    };
+
+    FOREACH_LEAF_STATE(LEAF_STATE_STRUCT)
+
+    #define USE_PARENT_STRUCT(STATE) using STATE = typename parents_t::STATE;
+    FOREACH_PARENT_STATE(USE_PARENT_STRUCT)
+
+    PSM_DECLARE_HIERARCHICAL_HANDLER_TABLE(nested_sm_t, FOREACH_NESTED_STATE)
+
+    void poll() {
+        psm_do_hierarchical_actions(*this, handler_table);
+    }
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    unsigned polls_in_state = 0;
+    unsigned entries        = 0;
+    unsigned parent_actions = 0;
+};
+
+template <typename sm_t>
+static double ns_per_poll(size_t num_polls, unsigned& entries, unsigned& parent_actions) {
+    sm_t sm;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_polls; ++i) {
+        sm.poll();
+        asm volatile("" : : "r"(&sm) : "memory");
+    }
+    const auto end = std::chrono::steady_clock::now();
+    entries        = sm.entries;
+    parent_actions = sm.parent_actions;
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_polls;
+}
+
+int main(int argc, char **argv) {
+    const size_t num_polls = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000000;
+
+    unsigned flat_entries   = 0, flat_parent_actions   = 0;
+    unsigned idle_entries   = 0, idle_parent_actions   = 0;
+    unsigned acting_entries = 0, acting_parent_actions = 0;
+    const double flat_ns   = ns_per_poll<flat_sm_t                      >(num_polls, flat_entries,   flat_parent_actions);
+    const double idle_ns   = ns_per_poll<nested_sm_t<idle_parents_t  >>(num_polls, idle_entries,   idle_parent_actions);
+    const double acting_ns = ns_per_poll<nested_sm_t<acting_parents_t>>(num_polls, acting_entries, acting_parent_actions);
+
+    std::cout << num_leaf_states << " leaf states, " << num_polls << " polls, " << flat_entries << " transitions\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "flat                   " << std::setw(8) << flat_ns   << " ns/poll\n";
+    std::cout << "nested, idle parents   " << std::setw(8) << idle_ns   << " ns/poll\n";
+    std::cout << "nested, acting parents " << std::setw(8) << acting_ns << " ns/poll, " << acting_parent_actions << " parent actions\n";
+
+    if (flat_entries != idle_entries || flat_entries != acting_entries) {
+        std::cout << "transition counts DIFFER: " << idle_entries << " and " << acting_entries << " nested\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
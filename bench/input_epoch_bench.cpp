@@ -0,0 +1,196 @@
+#include "psm_inputs.h"
+#include "psm_machine.h"
+#include "psm_timer_wheel.h"
+
+#include "X_macro_helpers.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Compares three ways of polling machines that each read one of many inputs:
+// every member every tick; psm_deadline_scheduler_t calling wake_all() on
+// every input change; and psm_deadline_scheduler_t with each member
+// subscribed to just the psm_input_t it reads.
+//
+// The machines are lamps in zones of equal size, cycling Red, Green and
+// Yellow with a dwell of 2 to 5 s and flashing while their zone's alarm input
+// is set. Every 10 ms one zone's alarm flips. All three must end with the same
+// states and the same number of state entries.
+//
+// Usage: input_epoch_bench [num_machines [num_zones [num_ticks]]]
+
+#define FOREACH_LAMP_STATE(X) \
+    X(Red)                    \
+    X(Green)                  \
+    X(Yellow)                 \
+    X(Flashing)               \
+
+static size_t now_ms;
+
+class zone_lamp_t : public psm_machine_t<zone_lamp_t> {
+public:
+    zone_lamp_t(const psm_input_t<bool>& alarm_, size_t dwell_ms_)
+        : alarm(alarm_)
+        , dwell_ms(dwell_ms_)
+    {}
+
+    size_t poll() {
+        size_t wake_ms = SIZE_MAX; // Only an alarm change wakes a Flashing lamp
+        do_actions(wake_ms);
+        return wake_ms;
+    }
+
+    enum class state_t : PSM_STATE_INDEX_TYPE(FOREACH_LAMP_STATE) {
+        unset,
+        FOREACH_LAMP_STATE(DECLARE_NAME)
+    };
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    size_t num_entries = 0;
+
+private:
+    friend psm_machine_t;
+
+    void dwell(size_t ms, state_t then, size_t& wake_ms) {
+        if (now_ms - state_entered_ms > ms) { next_state = then; }
+        else                                { wake_ms = state_entered_ms + ms + 1; }
+    }
+
+    void actions(PSM_ACTIONS_PARAMS, size_t& wake_ms) {
+        IF_ENTRY {
+            state_entered_ms = now_ms;
+            ++num_entries;
+        }
+        IF_DO {
+            if (alarm && state != state_t::Flashing) { next_state = state_t::Flashing; }
+        }
+
+        switch (state) {
+            case state_t::unset:    next_state = state_t::Red;                                   break;
+            case state_t::Red:      IF_DO { dwell(dwell_ms, state_t::Green,  wake_ms); }          break;
+            case state_t::Green:    IF_DO { dwell(dwell_ms, state_t::Yellow, wake_ms); }          break;
+            case state_t::Yellow:   IF_DO { dwell(1000,     state_t::Red,    wake_ms); }          break;
+            case state_t::Flashing: IF_DO { if (!alarm) { next_state = state_t::Red; } }          break;
+        }
+    }
+
+    const psm_input_t<bool>& alarm;
+    size_t                   state_entered_ms = 0;
+    size_t                   dwell_ms;
+};
+
+// What psm_deadline_scheduler_t polls.
+struct lamps_t {
+    lamps_t(const std::vector<std::unique_ptr<psm_input_t<bool>>>& alarms, size_t num_machines) {
+        const size_t zone_size = num_machines / alarms.size();
+        lamps.reserve(num_machines);
+        for (size_t i = 0; i < num_machines; ++i) {
+            lamps.emplace_back(*alarms[std::min(i / zone_size, alarms.size() - 1)], 2000 + i % 3000);
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return lamps.size(); }
+    size_t poll(size_t i) { ++num_polls; return lamps[i].poll(); }
+
+    std::vector<zone_lamp_t> lamps;
+    size_t                   num_polls = 0;
+};
+
+template <typename F>
+static double seconds_to_run(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000;
+    const size_t num_zones    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 100;
+    const size_t num_ticks    = argc > 3 ? strtoul(argv[3], nullptr, 0) : 20000;
+
+    std::vector<std::unique_ptr<psm_input_t<bool>>> alarms;
+    for (size_t z = 0; z < num_zones; ++z) {
+        alarms.push_back(std::make_unique<psm_input_t<bool>>(false));
+    }
+    const auto flip_alarm = [&] (size_t tick) { // Returns whether one flipped
+        if (tick % 10 != 0) {
+            return false;
+        }
+        psm_input_t<bool>& alarm = *alarms[(tick / 10) % num_zones];
+        return alarm.set(!alarm.get());
+    };
+    const auto reset_alarms = [&] {
+        for (auto& alarm : alarms) {
+            alarm->set(false);
+        }
+    };
+
+    lamps_t every_tick(alarms, num_machines);
+    now_ms = 0;
+    const double every_tick_s = seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            flip_alarm(now_ms);
+            for (size_t i = 0; i < num_machines; ++i) {
+                every_tick.poll(i);
+            }
+        }
+    });
+
+    reset_alarms();
+    lamps_t woken_all(alarms, num_machines);
+    now_ms = 0;
+    const double woken_all_s = seconds_to_run([&] {
+        psm_deadline_scheduler_t<lamps_t> scheduler(woken_all, now_ms);
+        for (; now_ms < num_ticks; ++now_ms) {
+            if (flip_alarm(now_ms)) {
+                scheduler.wake_all(now_ms);
+            }
+            scheduler.poll(now_ms);
+        }
+    });
+
+    reset_alarms();
+    lamps_t subscribed(alarms, num_machines);
+    now_ms = 0;
+    const double subscribed_s = seconds_to_run([&] {
+        psm_deadline_scheduler_t<lamps_t> scheduler(subscribed, now_ms);
+        const size_t zone_size = num_machines / num_zones;
+        for (size_t z = 0; z < num_zones; ++z) {
+            scheduler.subscribe(*alarms[z], z * zone_size, z + 1 == num_zones ? num_machines : (z + 1) * zone_size);
+        }
+        for (; now_ms < num_ticks; ++now_ms) {
+            flip_alarm(now_ms);
+            scheduler.poll(now_ms);
+        }
+    });
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_machines; ++i) {
+        const zone_lamp_t& a = every_tick.lamps[i];
+        for (const lamps_t *other : { &woken_all, &subscribed }) {
+            const zone_lamp_t& b = other->lamps[i];
+            mismatches += a.state != b.state || a.num_entries != b.num_entries;
+        }
+    }
+
+    const auto report = [&] (const char *name, double seconds, const lamps_t& lamps) {
+        std::cout
+            << std::left << std::setw(26) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1e6 / num_ticks << " us/tick"
+            << std::setw(12) << lamps.num_polls / num_ticks << " polls/tick\n";
+    };
+
+    std::cout << num_machines << " machines in " << num_zones << " zones x " << num_ticks << " ticks, a zone's alarm flipping every 10 ms\n";
+    report("poll every tick",          every_tick_s, every_tick);
+    report("wake_all() on change",     woken_all_s,  woken_all);
+    report("subscribed to zone alarm", subscribed_s, subscribed);
+    std::cout << "final states " << (mismatches ? "DIFFER" : "match") << "\n";
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "psm_fleet.h"
+#include "psm_mailbox.h"
+#include "stoplight_sm.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Measures event delivery through mailboxes while they are contended: several
+// producer threads post error and error-cleared events for random members of a
+// psm_fleet_t of stoplights, and one polling thread delivers them with
+// psm_deliver_events() before each fleet poll. A producer that finds the
+// mailbox full yields until it has room, and so does the polling thread when
+// it finds the mailbox empty, so the numbers mean something on machines with
+// fewer cores than threads.
+//
+// Runs psm_spsc_mailbox_t with one producer, then psm_mpsc_mailbox_t with one
+// producer up to max_producers.
+//
+// Usage: mailbox_bench [events_per_producer [max_producers [num_machines]]]
+
+using event_t = psm_addressed_event_t<stoplight_sm_t::event_t>;
+
+static constexpr size_t MAILBOX_CAPACITY = 1024;
+
+template <typename mailbox_t>
+static void run(const char *name, size_t num_producers, size_t events_per_producer, size_t num_machines) {
+    auto mailbox = std::make_unique<mailbox_t>();
+    psm_fleet_t<stoplight_sm_t> fleet(num_machines);
+
+    std::atomic<size_t> num_producing{ num_producers };
+    std::atomic<size_t> num_full{ 0 };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&, p] {
+            uint32_t rng = (uint32_t)p * 2654435761u + 1;
+            size_t   full = 0;
+            for (size_t i = 0; i < events_per_producer; ++i) {
+                rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; // xorshift32
+                const event_t event{ rng % (uint32_t)num_machines, i & 1 ? stoplight_sm_t::event_t::error_cleared : stoplight_sm_t::event_t::error };
+                while (!mailbox->try_post(event)) {
+                    ++full;
+                    std::this_thread::yield();
+                }
+            }
+            num_full += full;
+            --num_producing;
+        });
+    }
+
+    size_t num_delivered = 0;
+    size_t num_polls     = 0;
+    while (true) {
+        const bool producing = num_producing.load() != 0; // Sample before draining so nothing posted before it is missed
+        const size_t delivered = psm_deliver_events(fleet, *mailbox);
+        num_delivered += delivered;
+        fleet.poll();
+        if (!delivered) {
+            std::this_thread::yield(); // Let producers run when there are fewer cores than threads
+        }
+        ++num_polls;
+        ++now_ms;
+        if (!producing && num_delivered == num_producers * events_per_producer) {
+            break;
+        }
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout
+        << std::left << std::setw(22) << name
+        << std::right << std::setw(3) << num_producers << " producers"
+        << std::setw(14) << (size_t)(num_delivered / seconds) << " events/s"
+        << std::setw(10) << std::fixed << std::setprecision(2) << (double)num_delivered / num_polls << " events/poll"
+        << std::setw(10) << num_full.load() << " full\n";
+
+    if (num_delivered != num_producers * events_per_producer) {
+        std::cout << "LOST EVENTS\n";
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv) {
+    const size_t events_per_producer = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000000;
+    const size_t max_producers       = argc > 2 ? strtoul(argv[2], nullptr, 0) : 4;
+    const size_t num_machines        = argc > 3 ? strtoul(argv[3], nullptr, 0) : 64;
+
+    log_enabled = false;
+
+    std::cout << events_per_producer << " events per producer, " << num_machines << " machines, mailbox of " << MAILBOX_CAPACITY << "\n";
+
+    run<psm_spsc_mailbox_t<event_t, MAILBOX_CAPACITY>>("psm_spsc_mailbox_t", 1, events_per_producer, num_machines);
+    for (size_t num_producers = 1; num_producers <= max_producers; ++num_producers) {
+        run<psm_mpsc_mailbox_t<event_t, MAILBOX_CAPACITY>>("psm_mpsc_mailbox_t", num_producers, events_per_producer, num_machines);
+    }
+
+    return 0;
+}
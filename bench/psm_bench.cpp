@@ -0,0 +1,251 @@
+#include "psm_fleet.h"
+#include "stoplight_sm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Micro and macro benchmarks of the PSM core, written to stdout as JSON so
+// results from two versions can be diffed for regressions.
+//
+// Usage: psm_bench [scale]
+//
+// scale multiplies every benchmark's iteration count (default 1.0); use
+// something like 0.1 for a quick smoke run.
+
+////////////////////////////////////////////////////////////////////////////////
+// Harness
+
+template <typename T>
+static void do_not_optimize(T& value) {
+    asm volatile("" : "+m"(value) : : "memory");
+}
+
+struct result_t {
+    std::string name;
+    size_t      ops;
+    double      ns_per_op;
+};
+
+static std::vector<result_t> results;
+
+// Runs   op   (which performs   ops_per_call   operations) enough times to
+// amount to   ops   operations, five times over, and records the fastest run.
+//
+// If   op   returns how many of its operations did any work, as
+// psm_fleet_t::poll() does with the members it polled, that run's time per
+// operation that did is recorded as well, under   counted_name   .
+template <typename F>
+static void run(const char *name, size_t ops, size_t ops_per_call, F&& op, const char *counted_name = nullptr) {
+    const size_t calls = std::max<size_t>(ops / ops_per_call, 1);
+    double best_s = 1e300;
+    size_t best_counted = 0;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        size_t counted = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) {
+            if constexpr (std::is_void_v<decltype(op())>) {
+                op();
+            } else {
+                counted += op();
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const double s = std::chrono::duration<double>(end - start).count();
+        if (s < best_s) {
+            best_s       = s;
+            best_counted = counted;
+        }
+    }
+    results.push_back({ name, calls * ops_per_call, best_s * 1e9 / (calls * ops_per_call) });
+    if (counted_name) {
+        const size_t counted_ops = std::max<size_t>(best_counted, 1);
+        results.push_back({ counted_name, counted_ops, best_s * 1e9 / counted_ops });
+    }
+}
+
+static void emit_json() {
+    std::cout << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        std::cout
+            << "    { \"name\": \"" << r.name << "\""
+            << ", \"ops\": " << r.ops
+            << std::fixed << std::setprecision(3)
+            << ", \"ns_per_op\": " << r.ns_per_op
+            << std::setprecision(0)
+            << ", \"ops_per_s\": " << 1e9 / r.ns_per_op
+            << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A machine that isolates the PSM_DO_ACTIONS loop's own costs: no logging,
+// no clock, and fields the benchmarks may poke directly.
+
+#define FOREACH_BENCH_STATE(X) \
+    X(Idle)                    \
+    X(Other)                   \
+    X(Locked)                  \
+    X(Chain0)                  \
+    X(Chain1)                  \
+    X(Chain2)                  \
+    X(Chain3)                  \
+    X(Chain4)                  \
+    X(Chain5)                  \
+    X(Chain6)                  \
+    X(Chain7)                  \
+
+struct bench_sm_t {
+    enum class state_t {
+        unset,
+        FOREACH_BENCH_STATE(DECLARE_NAME)
+    };
+
+    void poll() {
+        PSM_DO_ACTIONS(*this) {
+            switch (state) {
+                case state_t::unset:
+                    next_state = state_t::Idle;
+                    break;
+
+                case state_t::Idle:
+                case state_t::Other:
+                    IF_ENTRY { ++entries; }
+                    IF_DO    { if (counter == ~0u) { next_state = state_t::unset; } }
+                    IF_EXIT  { ++exits; }
+                    break;
+
+                case state_t::Locked:
+                    IF_EXIT  { next_state = state; } // reject_transition()
+                    break;
+
+                case state_t::Chain7:
+                    IF_ENTRY { ++entries; }
+                    break;
+
+                default: // Chain0..Chain6 pass straight through to the next link
+                    IF_ENTRY { ++entries; next_state = (state_t)((int)state + 1); }
+                    break;
+            }
+        }
+    }
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    unsigned counter = 0;
+    unsigned entries = 0;
+    unsigned exits   = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks
+
+int main(int argc, char **argv) {
+    const double scale = argc > 1 ? strtod(argv[1], nullptr) : 1.0;
+    const auto ops = [&] (double n) { return std::max<size_t>((size_t)(n * scale), 1); };
+
+    log_enabled = false;
+
+    {
+        bench_sm_t sm;
+        sm.poll();
+        run("bench_sm.poll.steady", ops(2e8), 1, [&] { sm.poll(); do_not_optimize(sm); });
+    }
+
+    {
+        bench_sm_t sm;
+        sm.poll();
+        run("bench_sm.poll.one_transition", ops(5e7), 1, [&] {
+            sm.next_state = sm.state == bench_sm_t::state_t::Idle ? bench_sm_t::state_t::Other : bench_sm_t::state_t::Idle;
+            sm.poll();
+            do_not_optimize(sm);
+        });
+    }
+
+    {
+        bench_sm_t sm;
+        sm.poll();
+        run("bench_sm.poll.chain_of_8_transitions", ops(2e7), 1, [&] {
+            sm.state      = bench_sm_t::state_t::Idle;
+            sm.next_state = bench_sm_t::state_t::Chain0;
+            sm.poll();
+            do_not_optimize(sm);
+        });
+    }
+
+    {
+        bench_sm_t sm;
+        sm.state = sm.next_state = bench_sm_t::state_t::Locked;
+        run("bench_sm.poll.reject_transition", ops(5e7), 1, [&] {
+            sm.next_state = bench_sm_t::state_t::Idle;
+            sm.poll();
+            do_not_optimize(sm);
+        });
+    }
+
+    {
+        now_ms = 0;
+        stoplight_sm_t sm;
+        sm.poll();
+        run("stoplight_sm.poll.steady", ops(2e8), 1, [&] { sm.poll(); do_not_optimize(sm); });
+    }
+
+    {
+        now_ms = 0;
+        stoplight_sm_t sm;
+        sm.poll();
+        run("stoplight_sm.error_event_and_poll", ops(2e7), 2, [&] {
+            sm.handle_error_event();
+            sm.poll();
+            sm.handle_error_cleared_event();
+            sm.poll();
+            do_not_optimize(sm);
+        });
+    }
+
+    {
+        now_ms = 0;
+        stoplight_sm_t sm;
+        sm.poll();
+        some_hw_error_exists.set(true);
+        sm.poll();
+        some_hw_error_exists.set(false);
+        run("stoplight_sm.cleared_event_and_rejected_exit", ops(2e7), 1, [&] {
+            sm.handle_error_cleared_event();
+            sm.poll();
+            do_not_optimize(sm);
+        });
+    }
+
+    for (const size_t num_machines : { 1000, 100000, 1000000 }) {
+        psm_fleet_t<stoplight_sm_t> fleet(num_machines);
+        // Start each member at a different point in the 11 s Red, Green,
+        // Yellow cycle, as stoplights switched on at different times would
+        // be, rather than all in step, when the guard would skip every one of
+        // them on all but the ticks they all change lights together.
+        constexpr ms_t cycle_ms = 11003;
+        for (size_t i = 0; i < num_machines; ++i) {
+            now_ms = (ms_t)(i * 7919 % cycle_ms);
+            fleet.poll(i);
+        }
+        now_ms = cycle_ms;
+        fleet.poll();
+        // Report the time per member the fleet covers, comparable with
+        // polling each one, and per member the guard let through and it
+        // actually polled.
+        const std::string name   = "stoplight_fleet.poll." + std::to_string(num_machines);
+        const std::string polled = "stoplight_fleet.poll_polled." + std::to_string(num_machines);
+        run(name.c_str(), ops(1e8), num_machines, [&] { ++now_ms; return fleet.poll(); }, polled.c_str());
+    }
+
+    emit_json();
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "psm_fleet.h"
+#include "psm_rate_groups.h"
+#include "stoplight_sm.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+
+// Compares the CPU time of polling a mixed-rate fleet every tick against
+// polling it with psm_rate_groups_t at each machine class's declared period:
+// a tenth of the stoplights need 1 ms resolution, three tenths 10 ms, and the
+// rest 100 ms. Also reports the most members polled in any one tick, to show
+// that staggering spreads the slower groups evenly over the ticks rather
+// than polling each one all at once every period.
+//
+// Usage: rate_group_bench [num_machines [num_ticks]]
+
+struct stoplight_10ms_sm_t : stoplight_sm_t {
+    PSM_DECLARE_POLL_PERIOD(10)
+};
+
+struct stoplight_100ms_sm_t : stoplight_sm_t {
+    PSM_DECLARE_POLL_PERIOD(100)
+};
+
+struct mixed_fleet_t {
+    explicit mixed_fleet_t(size_t num_machines)
+        : fast  (num_machines / 10)
+        , medium(num_machines * 3 / 10)
+        , slow  (num_machines - fast.size() - medium.size())
+    {}
+
+    psm_fleet_t<stoplight_sm_t>       fast;
+    psm_fleet_t<stoplight_10ms_sm_t>  medium;
+    psm_fleet_t<stoplight_100ms_sm_t> slow;
+};
+
+template <typename F>
+static double cpu_seconds_to_run(F&& f) {
+    const std::clock_t start = std::clock();
+    f();
+    return double(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *name, size_t num_ticks, double seconds, size_t max_polls_per_tick) {
+    std::cout
+        << std::left << std::setw(20) << name
+        << std::right << std::setw(10) << std::fixed << std::setprecision(3) << seconds << " s CPU"
+        << std::setw(10) << std::setprecision(2) << seconds * 1e6 / num_ticks << " us/tick"
+        << std::setw(10) << max_polls_per_tick << " max polls/tick\n";
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 10000;
+
+    log_enabled = false;
+
+    mixed_fleet_t every_tick(num_machines);
+    now_ms = 0;
+    const double every_tick_s = cpu_seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            every_tick.fast.poll();
+            every_tick.medium.poll();
+            every_tick.slow.poll();
+        }
+    });
+
+    mixed_fleet_t     grouped(num_machines);
+    psm_rate_groups_t groups;
+    groups.add(grouped.fast);
+    groups.add(grouped.medium);
+    groups.add(grouped.slow);
+
+    size_t max_polls = 0;
+    size_t num_polls = 0;
+    now_ms = 0;
+    const double grouped_s = cpu_seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            const size_t polls = groups.poll(now_ms);
+            max_polls  = std::max(max_polls, polls);
+            num_polls += polls;
+        }
+    });
+
+    std::cout << num_machines << " machines (10% at 1 ms, 30% at 10 ms, 60% at 100 ms) x " << num_ticks << " ticks\n";
+    report("every tick",        num_ticks, every_tick_s, num_machines);
+    report("psm_rate_groups_t", num_ticks, grouped_s,    max_polls);
+    std::cout << "mean polls/tick " << num_polls / num_ticks << ", CPU saved " << std::setprecision(0) << 100 * (1 - grouped_s / every_tick_s) << "%\n";
+
+    return EXIT_SUCCESS;
+}
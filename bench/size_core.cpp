@@ -0,0 +1,48 @@
+#include "psm_machine.h"
+
+// The smallest useful machine on psm_machine_t, a blinker, for `make size` to
+// measure what the engine itself costs in flash and RAM, apart from any
+// machine's own logic or the mocks. The time is passed in, so nothing else is
+// linked.
+
+#define FOREACH_BLINKER_STATE(X) \
+    X(Off)                       \
+    X(On)                        \
+
+class blinker_t : public psm_machine_t<blinker_t> {
+public:
+    bool poll(uint32_t now_ms) {
+        do_actions(now_ms);
+        return state == state_t::On;
+    }
+
+private:
+    friend psm_machine_t;
+
+    enum class state_t : PSM_STATE_INDEX_TYPE(FOREACH_BLINKER_STATE) {
+        unset,
+        FOREACH_BLINKER_STATE(DECLARE_NAME)
+    };
+
+    void actions(PSM_ACTIONS_PARAMS, uint32_t now_ms) {
+        IF_ENTRY {
+            state_entered_ms = now_ms;
+        }
+
+        switch (state) {
+            case state_t::unset: next_state = state_t::Off; break;
+            case state_t::Off:   IF_DO { if (psm_elapsed_ms32(now_ms, state_entered_ms) >= 500) { next_state = state_t::On;  } } break;
+            case state_t::On:    IF_DO { if (psm_elapsed_ms32(now_ms, state_entered_ms) >= 500) { next_state = state_t::Off; } } break;
+        }
+    }
+
+    // Data members
+
+    PSM_DECLARE_PACKED_STATE_MACHINE_FIELDS(state_t)
+};
+
+blinker_t blinker;
+
+extern "C" bool size_core_poll(uint32_t now_ms) {
+    return blinker.poll(now_ms);
+}
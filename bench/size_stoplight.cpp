@@ -0,0 +1,25 @@
+#include "stoplight_sm.h"
+
+// Everything an MCU build of stoplight_sm_t carries, for `make size`: the
+// machine, its events, the mocks it sets lamps and logs through, and the
+// formatting of its log lines. External linkage keeps each from being
+// optimized away.
+
+stoplight_sm_t stoplight;
+
+extern "C" ms_t size_stoplight_poll() {
+    return stoplight.poll();
+}
+
+extern "C" void size_stoplight_handle_event(stoplight_sm_t::event_t event) {
+    stoplight.handle_event(event);
+}
+
+extern "C" void size_stoplight_drain_log() {
+    psm_trace_record_t record;
+    while (trace.try_pop(record)) {
+        mcu_log_line_t line;
+        stoplight_sm_t::emit_log_line(record, line);
+        mcu_console_write(line);
+    }
+}
@@ -0,0 +1,167 @@
+#include "psm_fleet.h"
+#include "psm_snapshot.h"
+#include "stoplight_sm.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Measures checkpointing a psm_fleet_t of stoplights with psm_save_snapshot()
+// and bringing it back with psm_restore_snapshot() on a clock that has moved
+// on, as after a restart, then runs the original and the restored fleet side
+// by side to check that every member carries on exactly where it left off.
+//
+// A third of the machines take an error event early on and every ninth is
+// cleared again, so the snapshot holds Errored machines as well as ones
+// cycling Red, Green and Yellow at assorted points in their dwells.
+//
+// Members' lamp images must match too, and a small fleet saved mid-Red must
+// have its Red lamps written out as it's restored, not at its next
+// transition. It also checks that a snapshot of another machine type, or
+// holding a state past the last one, is turned away with EINVAL.
+//
+// Usage: snapshot_bench [num_machines [snapshot_file]]
+
+using fleet_t = psm_fleet_t<stoplight_sm_t>;
+
+static constexpr ms_t SNAPSHOT_MS  = 7000;
+static constexpr ms_t RESTART_MS   = 4000000000; // Past a 32-bit wrap of the clock
+static constexpr ms_t COMPARE_TICKS = 10000;
+
+template <typename F>
+static double ms_to_run(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Whether psm_restore_snapshot() refuses   path   with the byte at   offset
+// flipped, leaving the fleet as it was. Puts the byte back after.
+static bool rejects_corrupted(const char *path, size_t offset, uint8_t flip) {
+    const int fd = ::open(path, O_RDWR);
+    uint8_t   byte = 0;
+    if (fd < 0 || pread(fd, &byte, 1, offset) != 1) {
+        return false;
+    }
+    byte ^= flip;
+    (void)!pwrite(fd, &byte, 1, offset);
+
+    fleet_t untouched(1);
+    errno = 0;
+    const bool refused = !psm_restore_snapshot(untouched, path, RESTART_MS) && errno == EINVAL && untouched.size() == 1;
+
+    byte ^= flip;
+    (void)!pwrite(fd, &byte, 1, offset);
+    ::close(fd);
+    return refused;
+}
+
+// Saves a fleet of Red stoplights and restores it with logging on, returning
+// whether restoring turned on each one's Red lamp.
+static bool relights_restored_lamps(const char *path) {
+    fleet_t red(16);
+    for (now_ms = 0; now_ms < 3000; ++now_ms) {
+        red.poll();
+    }
+    fleet_t restored(0);
+    if (!psm_save_snapshot(red, path, now_ms)) {
+        return false;
+    }
+    log_enabled = true;
+    const bool loaded = psm_restore_snapshot(restored, path, RESTART_MS);
+    log_enabled = false;
+    remove(path);
+
+    size_t             num_lit = 0;
+    psm_trace_record_t record;
+    while (trace.try_pop(record)) {
+        num_lit += record.kind == MCU_TRACE_SET_LIGHT && record.to == (uint16_t)mcu_lamp_t::Red && record.arg;
+    }
+    return loaded && num_lit == red.size();
+}
+
+static void deliver_events(fleet_t& fleet, ms_t ms) {
+    for (size_t i = 0; i < fleet.size(); i += 3) {
+        if (ms == 1000 + i % 2000) {
+            fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event(); });
+        }
+        if (i % 9 == 0 && ms == 4000 + i % 2000) {
+            fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); });
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000000;
+    const char  *path         = argc > 2 ? argv[2] : "snapshot_bench.psm";
+
+    log_enabled = false;
+
+    fleet_t original(num_machines);
+    for (now_ms = 0; now_ms < SNAPSHOT_MS; ++now_ms) {
+        deliver_events(original, now_ms);
+        original.poll();
+    }
+
+    bool saved = false;
+    const double save_ms = ms_to_run([&] { saved = psm_save_snapshot(original, path, now_ms); });
+    if (!saved) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    fleet_t restored(0);
+    bool loaded = false;
+    const double restore_ms = ms_to_run([&] { loaded = psm_restore_snapshot(restored, path, RESTART_MS); });
+    if (!loaded) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    stat(path, &st);
+
+    std::cout << num_machines << " machines, " << st.st_size / 1000 << " kB snapshot\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "save    " << std::setw(8) << save_ms    << " ms\n";
+    std::cout << "restore " << std::setw(8) << restore_ms << " ms\n";
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_machines; ++i) {
+        mismatches += original.outputs[i] != restored.outputs[i];
+    }
+    for (ms_t tick = 0; tick < COMPARE_TICKS; ++tick) {
+        now_ms = SNAPSHOT_MS + tick;
+        original.poll();
+        now_ms = RESTART_MS + tick;
+        restored.poll();
+    }
+    for (size_t i = 0; i < num_machines; ++i) {
+        mismatches += original.state[i] != restored.state[i]
+            || original.next_state[i] != restored.next_state[i]
+            || original.state_entered_ms[i] - (psm_ms32_t)SNAPSHOT_MS != restored.state_entered_ms[i] - (psm_ms32_t)RESTART_MS
+            || original.outputs[i] != restored.outputs[i];
+    }
+
+    const psm_snapshot_layout_t layout(num_machines, sizeof(fleet_t::state_t), fleet_t::has_budget, fleet_t::has_guards,
+                                       psm_snapshot_output_size<fleet_t>());
+    const bool rejected = num_machines == 0
+        || (rejects_corrupted(path, offsetof(psm_snapshot_header_t, type_tag), 1)
+            && rejects_corrupted(path, layout.state, 0x80)); // Past the last state
+
+    remove(path);
+
+    const bool relit = relights_restored_lamps(path);
+
+    std::cout << "after " << COMPARE_TICKS << " more ticks, restored states and lamps " << (mismatches ? "DIFFER" : "match") << "\n";
+    std::cout << "restored Red stoplights " << (relit ? "relit at once" : "NOT RELIT") << "\n";
+    std::cout << "corrupted snapshots " << (rejected ? "rejected" : "ACCEPTED") << "\n";
+    return mismatches || !relit || !rejected ? EXIT_FAILURE : EXIT_SUCCESS;
+}
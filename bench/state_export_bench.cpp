@@ -0,0 +1,170 @@
+#include "psm_fleet.h"
+#include "psm_state_export.h"
+#include "psm_work_stealing.h"
+#include "stoplight_sm.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Measures what publishing a fleet's states through psm_state_exporter_t
+// adds to each tick, polling through psm_work_stealing_scheduler_t and
+// publishing each shard as it's polled, and checks from a concurrent reader
+// that no copy of a shard is ever torn.
+//
+// Every 100 ticks every eighth shard gets an error event and 50 ticks later
+// an error cleared event. Members of a shard are otherwise in lockstep, so a
+// consistent copy of a shard has all of them in the same state, entered at
+// the same time; the reader counts copies that don't, and shards it gave up
+// on as busy or stale. Last, it marks a shard mid-publish for good, as a
+// writer that died while publishing would, and checks that reading it
+// reports it busy, as its sequence number moved since the last read, then
+// stale, rather than spinning forever.
+//
+// Usage: state_export_bench [num_machines [num_ticks [shard_size]]]
+
+using fleet_t = psm_fleet_t<stoplight_sm_t>;
+
+static void deliver_events(fleet_t& fleet, size_t shard_size, size_t tick) {
+    if (tick % 100 != 0 && tick % 100 != 50) {
+        return;
+    }
+    for (size_t begin = 0; begin < fleet.size(); begin += 8 * shard_size) {
+        for (size_t i = begin; i < std::min(begin + shard_size, fleet.size()); ++i) {
+            if (tick % 100 == 0) { fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event();         }); }
+            else                 { fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); }); }
+        }
+    }
+}
+
+template <typename F>
+static double seconds_to_run(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 2000;
+    const size_t shard_size   = argc > 3 ? strtoul(argv[3], nullptr, 0) : 4096;
+
+    log_enabled = false;
+
+    const std::string segment = "/psm_state_export_bench." + std::to_string(getpid());
+    psm_state_exporter_t<stoplight_sm_t> exporter;
+    if (!exporter.open(segment.c_str(), num_machines, shard_size)) {
+        perror(segment.c_str());
+        return EXIT_FAILURE;
+    }
+    psm_state_export_reader_t reader;
+    if (!reader.open(segment.c_str())) {
+        perror(segment.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const auto run = [&] (fleet_t& fleet, bool publish) {
+        psm_work_stealing_scheduler_t<fleet_t> scheduler(fleet, 1, shard_size);
+        if (publish) {
+            scheduler.on_shard_polled([&] (size_t shard, size_t, size_t) {
+                exporter.publish(fleet, shard, now_ms);
+            });
+        }
+        return seconds_to_run([&] {
+            for (now_ms = 0; now_ms < num_ticks; ++now_ms) {
+                deliver_events(fleet, shard_size, now_ms);
+                scheduler.poll();
+            }
+        });
+    };
+
+    fleet_t unpublished(num_machines);
+    const double unpublished_s = run(unpublished, false);
+
+    fleet_t published(num_machines);
+    const double published_s = run(published, true);
+
+    // Again, with a reader sampling the whole segment as fast as it can.
+    fleet_t sampled(num_machines);
+    std::atomic<bool> done{false};
+    size_t num_samples = 0, num_retries = 0, num_torn = 0, num_busy = 0, num_stale = 0;
+    std::thread sampler([&] {
+        std::vector<psm_exported_state_t> shard(shard_size);
+        uint32_t                          published_ms;
+        while (!done.load(std::memory_order_relaxed)) {
+            for (size_t s = 0; s < reader.num_shards(); ++s) {
+                const psm_shard_read_t read = reader.read_shard(s, shard.data(), published_ms, &num_retries);
+                if (read != psm_shard_read_t::ok) {
+                    num_busy  += read == psm_shard_read_t::busy; // The writer was preempted mid-publish for long enough
+                    num_stale += read == psm_shard_read_t::stale;
+                    continue;
+                }
+                const size_t n = std::min(shard_size, num_machines - s * shard_size);
+                for (size_t i = 1; i < n; ++i) {
+                    if (shard[i].state != shard[0].state || shard[i].state_entered_ms != shard[0].state_entered_ms) {
+                        ++num_torn;
+                        break;
+                    }
+                }
+            }
+            ++num_samples;
+        }
+    });
+    const double sampled_s = run(sampled, true);
+    done = true;
+    sampler.join();
+
+    size_t mismatches = 0;
+    std::vector<psm_exported_state_t> shard(shard_size);
+    uint32_t                          published_ms;
+    for (size_t s = 0; s < reader.num_shards(); ++s) {
+        mismatches += reader.read_shard(s, shard.data(), published_ms) != psm_shard_read_t::ok;
+        for (size_t i = s * shard_size; i < std::min((s + 1) * shard_size, num_machines); ++i) {
+            const psm_exported_state_t& exported = shard[i - s * shard_size];
+            mismatches += exported.state != (uint32_t)sampled.state[i]
+                || exported.state_entered_ms != sampled.state_entered_ms[i]
+                || sampled.state[i] != unpublished.state[i]
+                || published.state[i] != unpublished.state[i];
+        }
+    }
+
+    // A writer that dies mid-publish leaves its shard's sequence number odd.
+    bool stale_reported = false;
+    if (const int fd = shm_open(segment.c_str(), O_RDWR, 0); fd >= 0) {
+        const psm_state_export_layout_t layout(num_machines, reader.num_shards());
+        void *p = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p != MAP_FAILED) {
+            auto sequence = psm_shared_word(((psm_state_export_shard_t *)((char *)p + layout.shards))->sequence);
+            sequence.fetch_add(1);
+            stale_reported = reader.read_shard(0, shard.data(), published_ms) == psm_shard_read_t::busy
+                          && reader.read_shard(0, shard.data(), published_ms) == psm_shard_read_t::stale;
+            sequence.fetch_sub(1);
+            munmap(p, layout.size);
+        }
+    }
+
+    const auto ns_per_member = [&] (double seconds) { return seconds * 1e9 / ((double)num_machines * num_ticks); };
+
+    std::cout << num_machines << " machines x " << num_ticks << " ticks in shards of " << shard_size << ", single thread\n";
+    std::cout << std::fixed << std::setprecision(2)
+        << "poll                " << std::setw(8) << ns_per_member(unpublished_s) << " ns/member/tick\n"
+        << "poll and publish    " << std::setw(8) << ns_per_member(published_s)   << " ns/member/tick\n"
+        << "  with a reader     " << std::setw(8) << ns_per_member(sampled_s)     << " ns/member/tick (sharing the CPU if there's only one)\n"
+        << "reader              " << num_samples << " full samples, " << num_retries << " shard retries, " << num_torn << " torn shard copies, "
+                                  << num_busy << " busy, " << num_stale << " stale\n"
+        << "exported states " << (mismatches ? "DIFFER" : "match") << "\n"
+        << "shard left mid-publish " << (stale_reported ? "reported busy, then stale" : "NOT REPORTED BUSY, THEN STALE") << "\n";
+
+    return mismatches || num_torn || !stale_reported ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+#include "polling_state_machine.h"
+#include "psm_table.h"
+
+#include "X_macro_helpers.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Compares a 64-state machine dispatched through a   switch   inside
+// PSM_DO_ACTIONS() against the same machine dispatched through
+// PSM_DECLARE_HANDLER_TABLE().
+//
+// Every state has entry, do and exit actions, dwells one to three polls, and
+// then moves to a scattered successor, so each poll exercises dispatch with
+// poorly predictable state indices.
+//
+// Usage: table_bench [num_polls]
+
+#define FOREACH_BIG_STATE(X) \
+    X(S00) \
+    X(S01) \
+    X(S02) \
+    X(S03) \
+    X(S04) \
+    X(S05) \
+    X(S06) \
+    X(S07) \
+    X(S08) \
+    X(S09) \
+    X(S10) \
+    X(S11) \
+    X(S12) \
+    X(S13) \
+    X(S14) \
+    X(S15) \
+    X(S16) \
+    X(S17) \
+    X(S18) \
+    X(S19) \
+    X(S20) \
+    X(S21) \
+    X(S22) \
+    X(S23) \
+    X(S24) \
+    X(S25) \
+    X(S26) \
+    X(S27) \
+    X(S28) \
+    X(S29) \
+    X(S30) \
+    X(S31) \
+    X(S32) \
+    X(S33) \
+    X(S34) \
+    X(S35) \
+    X(S36) \
+    X(S37) \
+    X(S38) \
+    X(S39) \
+    X(S40) \
+    X(S41) \
+    X(S42) \
+    X(S43) \
+    X(S44) \
+    X(S45) \
+    X(S46) \
+    X(S47) \
+    X(S48) \
+    X(S49) \
+    X(S50) \
+    X(S51) \
+    X(S52) \
+    X(S53) \
+    X(S54) \
+    X(S55) \
+    X(S56) \
+    X(S57) \
+    X(S58) \
+    X(S59) \
+    X(S60) \
+    X(S61) \
+    X(S62) \
+    X(S63) \
+
+#define BIG_STATE_ENUM                      \
+    enum class state_t {                    \
+        unset,                              \
+        FOREACH_BIG_STATE(DECLARE_NAME)     \
+    };                                      \
+
+constexpr int num_big_states = M_NUM_DECLS_IN(FOREACH_BIG_STATE);
+
+// The actions both forms share, so they differ only in dispatch.
+
+template <typename sm_t>
+inline void big_entry(sm_t& sm, int) {
+    ++sm.entries;
+}
+
+template <typename sm_t>
+inline void big_do(sm_t& sm, int state) {
+    if (++sm.polls_in_state > (unsigned)(state % 3)) {
+        sm.next_state = (decltype(sm.state))(1 + (state * 37 + 11) % num_big_states);
+    }
+}
+
+template <typename sm_t>
+inline void big_exit(sm_t& sm, int) {
+    sm.polls_in_state = 0;
+}
+
+struct switch_sm_t {
+    BIG_STATE_ENUM
+
+    #define SWITCH_CASE(STATE)                                        \
+        case state_t::STATE:                                          \
+            IF_ENTRY { big_entry(*this, (int)state_t::STATE); }       \
+            IF_DO    { big_do   (*this, (int)state_t::STATE); }       \
+            IF_EXIT  { big_exit (*this, (int)state_t::STATE); }       \
+            break;                                                    \
+
+    void poll() {
+        PSM_DO_ACTIONS(*this) {
+            switch (state) {
+                case state_t::unset:
+                    next_state = state_t::S00;
+                    break;
+
+                FOREACH_BIG_STATE(SWITCH_CASE)
+            }
+        }
+    }
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    unsigned polls_in_state = 0;
+    unsigned entries        = 0;
+};
+
+struct table_sm_t {
+    BIG_STATE_ENUM
+
+    struct unset {
+        static void do_actions(table_sm_t& sm) { sm.next_state = state_t::S00; }
+    };
+
+    #define TABLE_STATE_STRUCT(STATE)                                                       \
+        struct STATE {                                                                      \
+            static void entry     (table_sm_t& sm) { big_entry(sm, (int)state_t::STATE); }  \
+            static void do_actions(table_sm_t& sm) { big_do   (sm, (int)state_t::STATE); }  \
+            static void exit      (table_sm_t& sm) { big_exit (sm, (int)state_t::STATE); }  \
+        };                                                                                  \
+
+    FOREACH_BIG_STATE(TABLE_STATE_STRUCT)
+
+    PSM_DECLARE_HANDLER_TABLE(table_sm_t, FOREACH_BIG_STATE)
+
+    void poll() {
+        psm_do_table_actions(*this, handler_table);
+    }
+
+    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+
+    unsigned polls_in_state = 0;
+    unsigned entries        = 0;
+};
+
+template <typename sm_t>
+static double ns_per_poll(size_t num_polls, unsigned& entries) {
+    sm_t sm;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_polls; ++i) {
+        sm.poll();
+        asm volatile("" : : "r"(&sm) : "memory");
+    }
+    const auto end = std::chrono::steady_clock::now();
+    entries = sm.entries;
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_polls;
+}
+
+int main(int argc, char **argv) {
+    const size_t num_polls = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000000;
+
+    unsigned switch_entries = 0;
+    unsigned table_entries  = 0;
+    const double switch_ns = ns_per_poll<switch_sm_t>(num_polls, switch_entries);
+    const double table_ns  = ns_per_poll<table_sm_t >(num_polls, table_entries);
+
+    std::cout << num_big_states << " states, " << num_polls << " polls, " << switch_entries << " transitions\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "switch dispatch " << std::setw(8) << switch_ns << " ns/poll\n";
+    std::cout << "table dispatch  " << std::setw(8) << table_ns  << " ns/poll\n";
+
+    if (switch_entries != table_entries) {
+        std::cout << "transition counts DIFFER: " << table_entries << " with table dispatch\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "psm_fleet.h"
+#include "psm_timer_wheel.h"
+#include "stoplight_sm.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Compares polling every member of a fleet on every tick against polling only
+// the members psm_deadline_scheduler_t reports as due.
+//
+// Usage: timer_wheel_bench [num_machines [num_ticks]]
+
+using fleet_t = psm_fleet_t<stoplight_sm_t>;
+
+template <typename F>
+static double seconds_to_run(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void report(const char *name, size_t num_ticks, double seconds) {
+    std::cout
+        << std::left << std::setw(24) << name
+        << std::right << std::setw(14) << std::fixed << std::setprecision(1) << seconds * 1e9 / num_ticks << " ns/tick\n";
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 20000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 30000;
+
+    const size_t error_ms   = num_ticks / 3;
+    const size_t cleared_ms = error_ms + 5000;
+
+    log_enabled = false;
+
+    fleet_t every_tick(num_machines);
+    now_ms = 0;
+    const double every_tick_s = seconds_to_run([&] {
+        for (; now_ms < num_ticks; ++now_ms) {
+            if (now_ms == error_ms  ) { for (size_t i = 0; i < num_machines; i += 2) every_tick.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event();         }); }
+            if (now_ms == cleared_ms) { for (size_t i = 0; i < num_machines; i += 2) every_tick.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); }); }
+            every_tick.poll();
+        }
+    });
+
+    fleet_t scheduled(num_machines);
+    now_ms = 0;
+    const double scheduled_s = seconds_to_run([&] {
+        psm_deadline_scheduler_t<fleet_t> scheduler(scheduled, now_ms);
+        for (; now_ms < num_ticks; ++now_ms) {
+            if (now_ms == error_ms  ) { for (size_t i = 0; i < num_machines; i += 2) { scheduled.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event();         }); scheduler.wake(i, now_ms); } }
+            if (now_ms == cleared_ms) { for (size_t i = 0; i < num_machines; i += 2) { scheduled.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); }); scheduler.wake(i, now_ms); } }
+            scheduler.poll(now_ms);
+        }
+    });
+
+    const bool match =
+           every_tick.state            == scheduled.state
+        && every_tick.next_state       == scheduled.next_state
+        && every_tick.state_entered_ms == scheduled.state_entered_ms;
+
+    std::cout << num_machines << " machines x " << num_ticks << " ticks\n";
+    report("poll every tick",       num_ticks, every_tick_s);
+    report("deadline scheduler",    num_ticks, scheduled_s);
+    std::cout << "speedup " << std::setprecision(1) << every_tick_s / scheduled_s << "x, final states " << (match ? "match" : "DIFFER") << "\n";
+
+    return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
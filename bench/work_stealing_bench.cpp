@@ -0,0 +1,110 @@
+#include "psm_fleet.h"
+#include "psm_work_stealing.h"
+#include "stoplight_sm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Runs the same fleet and event schedule through psm_work_stealing_scheduler_t
+// with 1 to N threads and reports tick completion latency percentiles.
+//
+// Every 100 ticks the first eighth of the fleet gets an error event and 50
+// ticks later an error cleared event, so a few shards see a burst of
+// transitions that stealing has to rebalance. Last, it runs a fleet that
+// doubles in size halfway through, as when stoplights are added between
+// ticks, and checks that the scheduler polls the new members too.
+//
+// Usage: work_stealing_bench [num_machines [num_ticks [max_threads]]]
+
+using fleet_t = psm_fleet_t<stoplight_sm_t>;
+
+static void deliver_events(fleet_t& fleet, size_t tick) {
+    const size_t burst_size = fleet.size() / 8;
+    if (tick % 100 == 0) {
+        for (size_t i = 0; i < burst_size; ++i) fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_event(); });
+    }
+    if (tick % 100 == 50) {
+        for (size_t i = 0; i < burst_size; ++i) fleet.visit(i, [] (stoplight_sm_t& sm) { sm.handle_error_cleared_event(); });
+    }
+}
+
+int main(int argc, char **argv) {
+    const size_t num_machines = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+    const size_t num_ticks    = argc > 2 ? strtoul(argv[2], nullptr, 0) : 2000;
+    const size_t max_threads  = argc > 3 ? strtoul(argv[3], nullptr, 0) : std::max(1u, std::thread::hardware_concurrency());
+
+    log_enabled = false;
+
+    fleet_t reference(num_machines);
+    for (now_ms = 0; now_ms < num_ticks; ++now_ms) {
+        deliver_events(reference, now_ms);
+        reference.poll();
+    }
+
+    std::cout << num_machines << " machines x " << num_ticks << " ticks; tick latency in us\n";
+    std::cout << "threads       p50       p90       p99     p99.9       max  final states\n";
+
+    bool all_match = true;
+    for (size_t num_threads = 1; num_threads <= max_threads; ++num_threads) {
+        fleet_t fleet(num_machines);
+        psm_work_stealing_scheduler_t<fleet_t> scheduler(fleet, num_threads);
+
+        std::vector<double> latencies_us;
+        latencies_us.reserve(num_ticks);
+        for (now_ms = 0; now_ms < num_ticks; ++now_ms) {
+            deliver_events(fleet, now_ms);
+            const auto start = std::chrono::steady_clock::now();
+            scheduler.poll();
+            const auto end = std::chrono::steady_clock::now();
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+
+        std::sort(latencies_us.begin(), latencies_us.end());
+        const auto percentile = [&] (double p) {
+            return latencies_us[std::min(latencies_us.size() - 1, (size_t)(p / 100 * latencies_us.size()))];
+        };
+
+        const bool match =
+               fleet.state            == reference.state
+            && fleet.next_state       == reference.next_state
+            && fleet.state_entered_ms == reference.state_entered_ms;
+        all_match = all_match && match;
+
+        std::cout
+            << std::setw(7) << num_threads << std::fixed << std::setprecision(1)
+            << std::setw(10) << percentile(50)
+            << std::setw(10) << percentile(90)
+            << std::setw(10) << percentile(99)
+            << std::setw(10) << percentile(99.9)
+            << std::setw(10) << latencies_us.back()
+            << "  " << (match ? "match" : "DIFFER") << "\n";
+    }
+
+    fleet_t grown_reference(num_machines / 2);
+    fleet_t grown(num_machines / 2);
+    {
+        psm_work_stealing_scheduler_t<fleet_t> scheduler(grown, max_threads);
+        for (now_ms = 0; now_ms < num_ticks; ++now_ms) {
+            if (now_ms == num_ticks / 2) {
+                grown_reference.resize(num_machines);
+                grown          .resize(num_machines);
+            }
+            deliver_events(grown_reference, now_ms);
+            grown_reference.poll();
+            deliver_events(grown, now_ms);
+            scheduler.poll();
+        }
+    }
+    const bool grown_match =
+           grown.state            == grown_reference.state
+        && grown.next_state       == grown_reference.next_state
+        && grown.state_entered_ms == grown_reference.state_entered_ms;
+    std::cout << "fleet grown mid-run: " << (grown_match ? "final states match" : "FINAL STATES DIFFER") << "\n";
+
+    return all_match && grown_match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
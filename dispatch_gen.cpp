@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Turns a dispatch profile, as written by a psm_state_profiler_t's
+// export_dispatch_profile(), into a header of dispatch hints for
+// PSM_PROFILED_CASE() (see psm_dispatch.h).
+//
+// Usage: dispatch_gen PREFIX [profile_file] > header
+//
+// Reads stdin if no profile_file is given. A state that took a quarter or
+// more of all passes through the actions is hot, one that took under 1% is
+// cold, and the rest are warm; PREFIX_HOT_STATES(X) lists the hot ones,
+// hottest first. Transitions are rare if under 1% of passes entered a new
+// state; the most frequent ones are listed in a comment for whoever reads the
+// header.
+
+struct state_counts_t {
+    std::string name;
+    size_t      passes  = 0;
+    size_t      entries = 0;
+};
+
+struct transition_counts_t {
+    std::string from;
+    std::string to;
+    size_t      count = 0;
+};
+
+static constexpr double HOT_SHARE  = 0.25;
+static constexpr double COLD_SHARE = 0.01;
+static constexpr double RARE_SHARE = 0.01;
+
+static constexpr size_t TRANSITIONS_LISTED = 8;
+
+static int usage() {
+    std::cerr << "usage: dispatch_gen PREFIX [profile_file]\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        return usage();
+    }
+    const std::string prefix = argv[1];
+
+    std::ifstream file;
+    if (argc > 2) {
+        file.open(argv[2]);
+        if (!file) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+    std::istream& in = argc > 2 ? file : std::cin;
+
+    size_t                           polls = 0;
+    std::vector<state_counts_t>      states;
+    std::vector<transition_counts_t> transitions;
+
+    std::string line;
+    for (size_t line_number = 1; std::getline(in, line); ++line_number) {
+        std::istringstream fields(line);
+        std::string        kind;
+        fields >> kind;
+
+        bool ok = true;
+        if (kind == "polls") {
+            ok = !!(fields >> polls);
+        }
+        else if (kind == "state") {
+            state_counts_t state;
+            size_t         exits;
+            ok = !!(fields >> state.name >> state.passes >> state.entries >> exits);
+            states.push_back(state);
+        }
+        else if (kind == "transition") {
+            transition_counts_t transition;
+            ok = !!(fields >> transition.from >> transition.to >> transition.count);
+            transitions.push_back(transition);
+        }
+        else if (!kind.empty()) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << (argc > 2 ? argv[2] : "stdin") << ":" << line_number << ": bad profile record: " << line << "\n";
+            return 1;
+        }
+    }
+
+    size_t passes = 0, entries = 0;
+    for (const state_counts_t& state : states) {
+        passes  += state.passes;
+        entries += state.entries;
+    }
+    if (passes == 0) {
+        std::cerr << "dispatch_gen: the profile has no passes\n";
+        return 1;
+    }
+
+    std::cout
+        << "#pragma once\n"
+        << "\n"
+        << "// Generated by dispatch_gen from a profile of " << polls << " polls, " << passes << " passes\n"
+        << "// through the actions and " << entries << " state entries. Include psm_dispatch.h too.\n"
+        << "\n";
+
+    const auto share_of = [&] (const state_counts_t& state) { return (double)state.passes / passes; };
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const state_counts_t& state : states) {
+        const double share = share_of(state);
+        const char *hint = share >= HOT_SHARE ? "PSM_HOT" : share < COLD_SHARE ? "PSM_COLD" : "PSM_WARM";
+        std::cout
+            << "#define " << std::left << std::setw(prefix.size() + 24) << (prefix + "_DISPATCH_" + state.name)
+            << std::setw(9) << hint << "// " << std::right << std::setw(6) << share * 100 << "% of passes\n";
+    }
+
+    std::vector<state_counts_t> hot_states;
+    std::copy_if(states.begin(), states.end(), std::back_inserter(hot_states), [&] (const auto& state) { return share_of(state) >= HOT_SHARE; });
+    std::stable_sort(hot_states.begin(), hot_states.end(), [] (const auto& a, const auto& b) { return a.passes > b.passes; });
+    std::cout << "\n#define " << prefix << "_HOT_STATES(X)";
+    for (const state_counts_t& state : hot_states) {
+        std::cout << " X(" << state.name << ")";
+    }
+    std::cout << "\n";
+
+    std::cout
+        << "\n"
+        << "// " << std::setprecision(4) << (double)entries / passes * 100 << "% of passes entered a new state\n"
+        << "#define " << prefix << "_TRANSITIONS_RARE " << ((double)entries / passes < RARE_SHARE) << "\n";
+
+    std::stable_sort(transitions.begin(), transitions.end(), [] (const auto& a, const auto& b) { return a.count > b.count; });
+    if (!transitions.empty()) {
+        std::cout << "\n// Most frequent transitions:\n";
+        for (size_t i = 0; i < std::min(transitions.size(), TRANSITIONS_LISTED); ++i) {
+            std::cout << "//    " << transitions[i].from << " -> " << transitions[i].to << ": " << transitions[i].count << "\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "stoplight_sm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Replays an input recording written by   stoplights -r input_file   through
+// one or many stoplight_sm_t machines as fast as possible, then reports
+// throughput.
+//
+// Usage: input_replay [-n num_machines] [-v trace_file] input_file
+//
+// Each machine starts from power-up and is polled only when a recorded input
+// changes or when the deadline its last poll() returned passes, never on the
+// idle ticks between. With -v, every machine's state transitions are checked
+// against those in trace_file, a trace written by the recorded run
+// (stoplights -r input_file trace_file); the exit status is 1 on any mismatch,
+// and 2 if trace records were dropped, which makes verifying impossible.
+
+struct transition_t {
+    uint64_t ms;
+    uint16_t from;
+    uint16_t to;
+
+    friend bool operator==(const transition_t&, const transition_t&) = default;
+};
+
+static std::vector<transition_t> read_transitions(FILE *in) {
+    std::vector<transition_t> transitions;
+    psm_trace_record_t        record;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (record.kind == PSM_TRACE_ENTERED) {
+            transitions.push_back({ record.ms, record.from, record.to });
+        }
+    }
+    return transitions;
+}
+
+// Checks the transitions logged since the last call against   expected  ,
+// returning false and reporting the first mismatch.
+static bool verify_transitions(size_t machine, const std::vector<transition_t>& expected, size_t& num_seen) {
+    bool               ok = true;
+    psm_trace_record_t record;
+    while (trace.try_pop(record)) {
+        if (record.kind != PSM_TRACE_ENTERED || !ok) {
+            continue;
+        }
+
+        const transition_t got{ record.ms, record.from, record.to };
+        if (num_seen >= expected.size() || !(got == expected[num_seen])) {
+            std::cerr << "machine " << machine << ": transition " << num_seen << " at " << got.ms << " ms does not match the recorded run\n";
+            ok = false;
+        }
+        ++num_seen;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t      num_machines = 1;
+    const char *trace_path   = nullptr;
+    const char *input_path   = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            num_machines = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-v") && i + 1 < argc) {
+            trace_path = argv[++i];
+        }
+        else {
+            input_path = argv[i];
+        }
+    }
+    if (!input_path) {
+        std::cerr << "usage: input_replay [-n num_machines] [-v trace_file] input_file\n";
+        return 1;
+    }
+
+    psm_input_replay_t inputs;
+    if (!inputs.open(input_path)) {
+        perror(input_path);
+        return 1;
+    }
+
+    std::vector<transition_t> expected;
+    if (trace_path) {
+        FILE *trace_file = fopen(trace_path, "rb");
+        if (!trace_file) {
+            perror(trace_path);
+            return 1;
+        }
+        expected = read_transitions(trace_file);
+        fclose(trace_file);
+    }
+
+    const bool verify = trace_path != nullptr;
+    log_enabled = verify;
+
+    size_t num_polls = 0;
+    ms_t   end_ms    = 0;
+    bool   ok        = true;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t machine = 0; machine < num_machines; ++machine) {
+        now_ms = 0;
+        simulate_hw_error(false);
+        simulate_emergency_vehicle_detected(false);
+        psm_trace_machine = (uint32_t)machine;
+
+        stoplight_sm_t sm;
+        ms_t           sm_wake_ms = 0;
+        size_t         num_seen   = 0;
+
+        // Checks each poll's transitions straight after it, so the trace ring
+        // never holds more than one poll's records however long the gaps
+        // between input changes are.
+        const auto poll = [&] {
+            sm_wake_ms = sm.poll();
+            ++num_polls;
+            if (verify) {
+                ok &= verify_transitions(machine, expected, num_seen);
+            }
+        };
+
+        const psm_input_record_t *record = inputs.begin();
+        while (record != inputs.end()) {
+            while (sm_wake_ms < record->ms) { // Deadlines before the next input change
+                now_ms = sm_wake_ms;
+                poll();
+            }
+
+            now_ms = record->ms;
+            if (record->input == PSM_INPUT_END) {
+                break;
+            }
+            for ( ; record != inputs.end() && record->ms == now_ms; ++record) { // All changes at this ms, then one poll
+                sm.apply_input(*record);
+            }
+            poll();
+        }
+        end_ms = now_ms;
+
+        // Without every record, neither a match nor a mismatch means anything.
+        if (trace.num_dropped() != 0) {
+            std::cerr << "machine " << machine << ": the trace ring dropped " << trace.num_dropped() << " records; cannot verify\n";
+            return 2;
+        }
+
+        if (verify && (ok &= verify_transitions(machine, expected, num_seen)) && num_seen != expected.size()) {
+            std::cerr << "machine " << machine << ": " << num_seen << " transitions, the recorded run had " << expected.size() << "\n";
+            ok = false;
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << num_machines << " machines x " << inputs.size() << " input records, " << end_ms << " ms each\n";
+    std::cout << num_polls / seconds << " polls/s, "
+              << num_machines * inputs.size() / seconds << " input records/s, "
+              << num_machines * end_ms / seconds / 1000 << " simulated s/s\n";
+    if (verify) {
+        std::cout << (ok ? "transitions match the recorded run\n" : "TRANSITIONS DIFFER FROM THE RECORDED RUN\n");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "psm_format.h"
+#include "psm_input_trace.h"
+#include "psm_inputs.h"
+#include "psm_output_port.h"
+#include "psm_trace.h"
+
+#include "X_macro_helpers.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <unistd.h>
+
+// Mocks of the facilities a typical bare-metal MCU main.c provides.
+//
+// Built with -DPSM_EMBEDDED (make stoplights_embedded, make size), the mocks
+// and the stoplight machine use no iostreams, threads or heap, as on an MCU
+// with no C++ runtime to speak of: log text is formatted into fixed buffers
+// and written to the console, and the trace ring shrinks to
+// MCU_TRACE_CAPACITY records.
+
+// Timekeeping typical of a tiny bare metal MCU
+//
+// now_ms   is the current tick's time: the main loop sets it once per tick,
+// from a psm_clock.h backend, and the machines only ever read it.
+
+typedef size_t ms_t;
+
+inline ms_t now_ms;
+
+[[nodiscard]] inline size_t elapsed_ms(ms_t ms) {
+    return now_ms > ms
+        ? (size_t)(now_ms - ms)
+        : 0u;
+}
+
+// Logging
+//
+// Nothing is formatted while polling: the mocks and machines append compact
+// binary records to   trace   with log_event(), and the main loop drains it
+// between ticks, decoding each record to the text the log has always shown or
+// dumping the raw records to a file for trace_decode. Set   log_enabled
+// false to drop records entirely, as the benchmarks do.
+//
+// Each record decodes to one line of at most MCU_LOG_LINE_SIZE characters.
+
+#ifndef MCU_TRACE_CAPACITY
+#ifdef PSM_EMBEDDED
+#define MCU_TRACE_CAPACITY 64 // The main loop drains it every tick
+#else
+#define MCU_TRACE_CAPACITY 4096
+#endif
+#endif
+
+inline psm_trace_ring_t<MCU_TRACE_CAPACITY> trace;
+
+inline constexpr size_t MCU_LOG_LINE_SIZE = 96;
+
+using mcu_log_line_t = psm_format_buffer_t<MCU_LOG_LINE_SIZE>;
+
+inline bool log_enabled = true;
+
+[[gnu::noinline]] inline void push_log_event(uint8_t kind, size_t to, size_t from, bool arg) {
+    psm_trace_record_t record{};
+    record.ms      = now_ms;
+    record.kind    = kind;
+    record.arg     = arg;
+    record.machine = psm_trace_machine;
+    record.from    = (uint16_t)from;
+    record.to      = (uint16_t)to;
+    trace.try_push(record);
+}
+
+inline void log_event(uint8_t kind, size_t to, size_t from = 0, bool arg = false) {
+    if (log_enabled) {
+        push_log_event(kind, to, from, arg); // Out of line so poll() stays small enough to inline
+    }
+}
+
+enum mcu_trace_kind_t : uint8_t {
+    MCU_TRACE_SET_LIGHT = PSM_TRACE_FIRST_USER_KIND, // to: lamp, arg: on
+    MCU_TRACE_INPUT,                                 // to: input, arg: value
+    MCU_TRACE_FIRST_USER_KIND,
+};
+
+inline void emit_log_prefix(mcu_log_line_t& line, ms_t ms) {
+    line << psm_setw(5) << ms << " ";
+}
+
+// Appends   name   , or if it's nullptr, the raw   index   it was looked up by,
+// as for a record from a build with more lamps, inputs or states than this
+// one, or a corrupt trace file.
+inline void emit_name(mcu_log_line_t& line, const char *name, size_t index) {
+    if (name) {
+        line << name;
+    }
+    else {
+        line << index;
+    }
+}
+
+// The console, a UART on a real MCU: writes   line   out, blocking until it's
+// gone.
+inline void mcu_console_write(const mcu_log_line_t& line) {
+    for (size_t written = 0; written < line.size(); ) {
+        const ssize_t n = ::write(STDOUT_FILENO, line.data() + written, line.size() - written);
+        if (n <= 0) {
+            return; // Nowhere for it to go
+        }
+        written += n;
+    }
+}
+
+// Output controller for the actual lamps
+//
+// Every stoplight has lamps of its own, so each machine keeps the image of its
+// lamps, an mcu_lamps_t, and writes the ones that changed at the end of each
+// poll with write_lamps(): turning lamps off, then on, as a driver switching
+// one output register would.
+
+#define FOREACH_MCU_LAMP(X) \
+    X(Red)                  \
+    X(Yellow)               \
+    X(Green)                \
+
+enum class mcu_lamp_t : uint8_t {
+    FOREACH_MCU_LAMP(DECLARE_NAME)
+};
+
+inline const char *const lamp_names[] = {
+    FOREACH_MCU_LAMP(DECLARE_STRING)
+};
+
+using mcu_lamps_t = psm_output_image_t<mcu_lamp_t, uint8_t>;
+
+static_assert(M_NUM_DECLS_IN(FOREACH_MCU_LAMP) <= mcu_lamps_t::num_bits, "too many lamps for one image");
+
+[[gnu::noinline]] inline void write_lamps(uint8_t image, uint8_t changed) {
+    for (bool on : { false, true }) {
+        for (size_t lamp = 0; lamp < M_NUM_DECLS_IN(FOREACH_MCU_LAMP); ++lamp) {
+            if ((changed >> lamp & 1) && (image >> lamp & 1) == on) {
+                log_event(MCU_TRACE_SET_LIGHT, lamp, 0, on);
+            }
+        }
+    }
+}
+
+// Unusual Conditions
+
+#define FOREACH_MCU_INPUT(X)      \
+    X(some_hw_error_exists)       \
+    X(emergency_vehicle_detected) \
+
+enum class mcu_input_t {
+    FOREACH_MCU_INPUT(DECLARE_NAME)
+};
+
+inline const char *const input_names[] = {
+    FOREACH_MCU_INPUT(DECLARE_STRING)
+};
+
+// Input recording: while   input_recorder   is open, every input change and
+// every event delivered to a machine is appended to it, numbered as
+// mcu_input_t and then from MCU_FIRST_USER_INPUT for the machines' events.
+
+enum : uint8_t {
+    MCU_FIRST_USER_INPUT = M_NUM_DECLS_IN(FOREACH_MCU_INPUT),
+};
+
+// Embedded builds have nowhere to record to.
+
+#ifndef PSM_EMBEDDED
+inline psm_input_recorder_t input_recorder;
+#endif
+
+inline void record_input([[maybe_unused]] uint8_t input, [[maybe_unused]] bool value) {
+#ifndef PSM_EMBEDDED
+    if (input_recorder.is_open()) {
+        input_recorder.record(now_ms, input, value);
+    }
+#endif
+}
+
+// Each is a psm_input_t, so a psm_deadline_scheduler_t can wake just the
+// machines subscribed to it when it changes.
+
+inline psm_input_t<bool> some_hw_error_exists;
+
+inline void simulate_hw_error(bool some_hw_error_exists_) {
+    if (some_hw_error_exists.set(some_hw_error_exists_)) {
+        log_event(MCU_TRACE_INPUT, (size_t)mcu_input_t::some_hw_error_exists, 0, some_hw_error_exists);
+        record_input((uint8_t)mcu_input_t::some_hw_error_exists, some_hw_error_exists);
+    }
+}
+
+inline psm_input_t<bool> emergency_vehicle_detected;
+
+inline void simulate_emergency_vehicle_detected(bool emergency_vehicle_detected_) {
+    if (emergency_vehicle_detected.set(emergency_vehicle_detected_)) {
+        log_event(MCU_TRACE_INPUT, (size_t)mcu_input_t::emergency_vehicle_detected, 0, emergency_vehicle_detected);
+        record_input((uint8_t)mcu_input_t::emergency_vehicle_detected, emergency_vehicle_detected);
+    }
+}
+
+// Applies a recorded input change, returning false for inputs that are not
+// the mocks'.
+inline bool apply_mcu_input(const psm_input_record_t& record) {
+    switch (record.input) {
+        case (uint8_t)mcu_input_t::some_hw_error_exists:       simulate_hw_error(record.value);                   return true;
+        case (uint8_t)mcu_input_t::emergency_vehicle_detected: simulate_emergency_vehicle_detected(record.value); return true;
+    }
+    return false;
+}
+
+// Formats the line for a record logged by the mocks, returning false for any
+// other kind.
+inline bool emit_mcu_log_line(const psm_trace_record_t& record, mcu_log_line_t& line) {
+    switch (record.kind) {
+        case MCU_TRACE_SET_LIGHT:
+            emit_log_prefix(line, record.ms);
+            line << "set_light(): ";
+            emit_name(line, record.to < M_NUM_DECLS_IN(FOREACH_MCU_LAMP) ? lamp_names[record.to] : nullptr, record.to);
+            line << " " << (record.arg ? "on" : "off") << "\n";
+            return true;
+
+        case MCU_TRACE_INPUT:
+            emit_log_prefix(line, record.ms);
+            emit_name(line, record.to < M_NUM_DECLS_IN(FOREACH_MCU_INPUT) ? input_names[record.to] : nullptr, record.to);
+            line << ": " << (unsigned)record.arg << "\n";
+            return true;
+    }
+    return false;
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "X_macro_helpers.h"
+
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
 
 // See the main state machine for example code
 
@@ -10,6 +15,63 @@
     state_t state{};                              \
     state_t next_state{};                         \
 
+// The smallest unsigned type that can index every state in an X macro state
+// list plus the   unset   state, for use as the state enum's underlying type:
+//
+//    enum class state_t : PSM_STATE_INDEX_TYPE(FOREACH_MY_STATE) {
+//        unset,
+//        FOREACH_MY_STATE(DECLARE_NAME)
+//    };
+//
+#define PSM_STATE_INDEX_TYPE(FOREACH_STATE) psm_state_index_t<M_NUM_DECLS_IN(FOREACH_STATE) + 1>
+
+template <size_t num_states>
+using psm_state_index_t =
+    std::conditional_t<num_states <= 0x100,   uint8_t,
+    std::conditional_t<num_states <= 0x10000, uint16_t,
+                                              uint32_t>>;
+
+// Identifies a machine class to code that keeps its states outside the
+// process, such as psm_snapshot.h, so states saved by another class, or by a
+// build with a different state list, aren't taken for its own. In a public
+// section of the machine,
+//
+//    PSM_DECLARE_MACHINE_TYPE("stoplight", FOREACH_STOPLIGHT_STATE)
+//
+// declares   psm_num_states   , the number of states counting   unset   , and
+// psm_type_tag   , a hash of the name and the state names in order.
+#define PSM_DECLARE_MACHINE_TYPE(name, FOREACH_STATE)                                                 \
+    static constexpr size_t   psm_num_states = M_NUM_DECLS_IN(FOREACH_STATE) + 1;                   \
+    static constexpr uint64_t psm_type_tag   = psm_fnv1a_64(name FOREACH_STATE(PSM_STATE_NAME_TEXT_)); \
+
+#define PSM_STATE_NAME_TEXT_(SYMBOL, ...) " " #SYMBOL
+
+[[nodiscard]] constexpr uint64_t psm_fnv1a_64(const char *text) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (; *text; ++text) {
+        hash = (hash ^ (uint8_t)*text) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// A packed alternative to PSM_DECLARE_STATE_MACHINE_FIELDS() for machines that
+// time their states: state and next_state side by side, followed by a
+// state_entered_ms   holding only the low 32 bits of the millisecond clock.
+// With a PSM_STATE_INDEX_TYPE() enum that's 8 bytes per instance.
+//
+// Use psm_elapsed_ms32() to read the time in state; it's exact for up to 2^32
+// ms (~49.7 days) in one state, after which it wraps around to 0.
+#define PSM_DECLARE_PACKED_STATE_MACHINE_FIELDS(state_t) \
+    state_t    state{};                                  \
+    state_t    next_state{};                             \
+    psm_ms32_t state_entered_ms{};                       \
+
+typedef uint32_t psm_ms32_t;
+
+[[nodiscard]] inline uint32_t psm_elapsed_ms32(size_t now_ms, psm_ms32_t since_ms) {
+    return (psm_ms32_t)now_ms - since_ms; // Modulo 2^32
+}
+
 // Action Block Keywords
 // =====================
 //
@@ -53,6 +115,8 @@
 //
 // To have multiple states share actions, define multiple dispatchers, one or
 // more for the shared actions, and one or more for the state-specific actions.
+// For states nested in parent states, psm_hierarchy.h does this at compile
+// time.
 //
 // If a state has multiple IF_ENTRY action blocks and one of the first ones alters
 // my_sm.next_state  , the ones will run; the state is fully entered.
@@ -66,24 +130,92 @@
 //
 #define IF_ENTRY if (*psm_state !=  psm_prev_state)
 #define IF_DO    if (*psm_state == *psm_next_state)
-#define IF_EXIT  if (*psm_state != *psm_next_state)
+#define IF_EXIT  if (*psm_state != *psm_next_state && psm_profile_exit_block(psm_state))
 
 // Wrap all of the state machine's actions logic in a loop using this macro as though it were
 // a for loop.
-#define PSM_DO_ACTIONS(instance)                                           \
-    for (                                                                  \
-        typeof((instance).state)  psm_prev_state =  (instance).state,      \
-                                 *psm_state      = &(instance).state,      \
-                                 *psm_next_state = &(instance).next_state; \
-        psm_state != NULL;                                                 \
-        [&] () {                                                           \
-            psm_prev_state   = (instance).state;                           \
-            (instance).state = (instance).next_state;                      \
-            if (psm_prev_state == (instance).next_state) {                 \
-                psm_state = NULL; /* No change, exit the loop */           \
-            }                                                              \
-        }()                                                                \
-    )                                                                      \
+#define PSM_DO_ACTIONS(instance)                                                                  \
+    for (                                                                                         \
+        typeof((instance).state)  psm_prev_state =  psm_profile_poll_begin(&(instance).state),    \
+                                 *psm_state      = &(instance).state,                             \
+                                 *psm_next_state = &(instance).next_state;                        \
+        psm_state != NULL;                                                                        \
+        [&] () {                                                                                  \
+            psm_profile_iteration((instance), psm_prev_state, (instance).state, (instance).next_state); \
+            psm_prev_state   = (instance).state;                                                  \
+            (instance).state = (instance).next_state;                                             \
+            if (psm_prev_state == (instance).next_state) {                                        \
+                psm_state = NULL; /* No change, exit the loop */                                  \
+                psm_profile_poll_end(psm_prev_state);                                             \
+            }                                                                                     \
+        }()                                                                                       \
+    )                                                                                             \
+
+// Profiling Hooks
+// ===============
+//
+// PSM_DO_ACTIONS() and IF_EXIT report each poll, loop iteration and exit block
+// to the profiler chosen for the machine's state enum. That's
+// psm_null_profiler_t, whose hooks are empty and inline away to nothing, unless
+// the machine names another with PSM_DECLARE_PROFILER() after declaring its
+// state enum, usually a psm_state_profiler_t (see psm_profile.h):
+//
+//    enum class state_t { unset, FOREACH_TRAFFIC_LIGHT_STATE(DECLARE_NAME) };
+//
+//    PSM_DECLARE_PROFILER(psm_state_profiler_t<state_t, num_traffic_light_states>)
+//
+#define PSM_DECLARE_PROFILER(profiler_t) friend profiler_t psm_profiler_of(state_t);
+
+template <typename state_t>
+struct psm_null_profiler_t {
+    static constexpr bool enabled = false;
+
+    static void on_poll_begin() {}
+    static void on_exit_block() {}
+    template <typename sm_t>
+    static void on_iteration(const sm_t&, state_t /* prev_state */, state_t /* state */, state_t /* next_state */) {}
+    static void on_budget_exhausted() {}
+    static void on_poll_end() {}
+};
+
+// Never defined; only used to look up the profiler by argument dependent
+// lookup, which finds a PSM_DECLARE_PROFILER() friend in preference to this.
+template <typename state_t>
+psm_null_profiler_t<state_t> psm_profiler_of(state_t);
+
+template <typename state_t>
+using psm_profiler_t = decltype(psm_profiler_of(state_t{}));
+
+template <typename state_t>
+inline state_t psm_profile_poll_begin(const state_t *state) {
+    psm_profiler_t<state_t>::on_poll_begin();
+    return *state;
+}
+
+template <typename state_t>
+inline bool psm_profile_exit_block(const state_t *) {
+    psm_profiler_t<state_t>::on_exit_block();
+    return true;
+}
+
+// Called after each pass through the actions, before   state   advances to
+// next_state   .
+template <typename sm_t, typename state_t>
+inline void psm_profile_iteration(const sm_t& sm, state_t prev_state, state_t state, state_t next_state) {
+    psm_profiler_t<state_t>::on_iteration(sm, prev_state, state, next_state);
+}
+
+// Called when a poll stops with a transition pending because the machine's
+// PSM_DECLARE_TRANSITION_BUDGET() ran out, just before psm_profile_poll_end().
+template <typename state_t>
+inline void psm_profile_budget_exhausted(state_t) {
+    psm_profiler_t<state_t>::on_budget_exhausted();
+}
+
+template <typename state_t>
+inline void psm_profile_poll_end(state_t) {
+    psm_profiler_t<state_t>::on_poll_end();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // Copyright (c) Robert Barrie Slaymaker, Jr.
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+
+#ifndef PSM_EMBEDDED
+#include <chrono>
+#include <thread>
+#endif
+
+#include <time.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(PSM_EMBEDDED)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define PSM_HAVE_TSC_CLOCK 1
+#endif
+
+// Monotonic millisecond clocks for driving polling state machines.
+//
+// Machines never read a clock themselves: each tick, the main loop reads one
+// of these once and stores the result where the machines look (now_ms in the
+// mocks), so the many elapsed_ms() calls a fleet makes per tick each cost a
+// load rather than a syscall, vDSO call or TSC read. Every backend has
+//
+//    uint64_t read_ms();   // ms since an arbitrary, fixed point
+//
+// and psm_wait_until() waits for (or, for psm_virtual_clock_t, moves to) a
+// given time. bench/clock_bench measures each one's cost per read, its
+// resolution and its skew against std::chrono::steady_clock.
+//
+// Built with -DPSM_EMBEDDED, only the coarse and virtual clocks are left, as
+// the others need <chrono> and <thread>, and waiting spins without yielding.
+
+#ifndef PSM_EMBEDDED
+// std::chrono::steady_clock: portable; a vDSO call on Linux.
+class psm_steady_clock_t {
+public:
+    [[nodiscard]] uint64_t read_ms() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+#endif
+
+// CLOCK_MONOTONIC_COARSE: cheaper than steady_clock, but only advances once
+// per kernel tick (typically every 1 to 4 ms).
+class psm_coarse_clock_t {
+public:
+    [[nodiscard]] uint64_t read_ms() const {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    }
+};
+
+#if PSM_HAVE_TSC_CLOCK
+// The time stamp counter, calibrated against steady_clock on construction:
+// a few ns per read and no syscall. Only trustworthy where is_invariant(),
+// i.e. where the TSC ticks at a constant rate in all power states and is
+// synchronized across cores.
+class psm_tsc_clock_t {
+public:
+    explicit psm_tsc_clock_t(uint64_t calibration_ms = 20) {
+        const psm_steady_clock_t steady;
+        const auto     start     = std::chrono::steady_clock::now();
+        const uint64_t start_tsc = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(calibration_ms));
+        const auto     end       = std::chrono::steady_clock::now();
+        const uint64_t end_tsc   = __rdtsc();
+
+        const double ticks_per_ms = (double)(end_tsc - start_tsc) / std::chrono::duration<double, std::milli>(end - start).count();
+        ms_per_tick_q64 = (uint64_t)(18446744073709551616.0 / ticks_per_ms); // 2^64 / ticks_per_ms
+        base_tsc        = end_tsc;
+        base_ms         = steady.read_ms();
+    }
+
+    [[nodiscard]] uint64_t read_ms() const {
+        __extension__ typedef unsigned __int128 uint128_t;
+        return base_ms + (uint64_t)(((uint128_t)(__rdtsc() - base_tsc) * ms_per_tick_q64) >> 64);
+    }
+
+    [[nodiscard]] static bool is_invariant() {
+        unsigned eax, ebx, ecx, edx;
+        return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+    }
+
+private:
+
+    uint64_t ms_per_tick_q64;
+    uint64_t base_tsc;
+    uint64_t base_ms;
+};
+#endif
+
+// Simulated time that moves only when told to, for tests, benchmarks and
+// fast-forward simulation.
+class psm_virtual_clock_t {
+public:
+    [[nodiscard]] uint64_t read_ms() const {
+        return ms;
+    }
+
+    void advance_to(uint64_t ms_) {
+        ms = ms_;
+    }
+
+private:
+
+    uint64_t ms = 0;
+};
+
+// Returns once   clock   reads at least   ms  . Real clocks are spun on,
+// yielding the CPU between reads; psm_virtual_clock_t jumps straight there.
+template <typename clock_t>
+void psm_wait_until(clock_t& clock, uint64_t ms) {
+    if constexpr (requires { clock.advance_to(ms); }) {
+        clock.advance_to(ms);
+    }
+    else {
+        while (clock.read_ms() < ms) {
+#ifndef PSM_EMBEDDED
+            std::this_thread::yield();
+#endif
+        }
+    }
+}
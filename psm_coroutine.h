@@ -0,0 +1,410 @@
+#pragma once
+
+#include "polling_state_machine.h"
+#include "psm_inputs.h"
+#include "psm_machine.h"
+#include "psm_timer_wheel.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// A coroutine flavor of polling state machine: instead of returning from an
+// IF_DO block and being polled again to see whether a deadline has passed or
+// an input has changed, a state can   co_await   exactly that, and a
+// single-threaded executor resumes only the machines that are ready.
+//
+//    class blinker_t : public psm_co_machine_t<blinker_t> {
+//    public:
+//        using psm_co_machine_t::psm_co_machine_t;
+//
+//    private:
+//        friend psm_co_machine_t;
+//
+//        psm_task_t actions(PSM_CO_ACTIONS_PARAMS) {
+//            PSM_CO_PASSES {
+//                switch (state) {
+//                    case state_t::off:
+//                        IF_ENTRY { set_light(false); }
+//                        IF_DO {
+//                            if (button.get() || elapsed_ms() >= 500) { set_next_state(state_t::on); }
+//                            else { co_await wait_until(state_entered_ms + 500, button); }
+//                        }
+//                        IF_EXIT  { ... }
+//                        break;
+//                    ...
+//                }
+//            }
+//        }
+//        ...
+//    };
+//
+// actions() is a coroutine that start() calls once: its one frame, allocated
+// then, lives as long as the machine. The body of PSM_CO_PASSES is exactly
+// what psm_machine_t's actions() would hold: it runs once per pass, IF_ENTRY,
+// IF_DO and IF_EXIT mean what they do there, and an IF_EXIT block can still
+// cancel the transition with reject_transition(). A pass that suspends simply
+// finishes later, when it is resumed; the pass after it starts at once. A
+// pass that neither suspends nor changes state parks the machine, at the end
+// of the pass, until wake() is called, which event handlers must do after
+// changing next_state.
+//
+// Awaiting wakes at the deadline or on the first change to any watched input,
+// whichever is first. Await as the last thing a pass does, as above: the pass
+// then ends without a transition and the next one re-checks every condition
+// in the order a poll would, so the machine behaves exactly like its polled
+// form, just without the polls that would have found nothing to do. A
+// deadline that has already passed wakes at the next run().
+// Machines must not move once start()ed, as their coroutines point at them.
+
+class psm_task_t {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        psm_task_t get_return_object() {
+            return psm_task_t{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct resume_continuation_t {
+                bool await_ready() noexcept { return false; }
+                void await_resume() noexcept {}
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+                    return done.promise().continuation;
+                }
+            };
+            return resume_continuation_t{};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    psm_task_t() = default;
+
+    psm_task_t(psm_task_t&& other) : handle(std::exchange(other.handle, {})) {}
+
+    psm_task_t& operator=(psm_task_t&& other) {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+
+    ~psm_task_t() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    // Awaiting a task runs it to completion, then resumes the awaiter.
+    bool await_ready() const { return false; }
+    void await_resume() const {}
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    [[nodiscard]] std::coroutine_handle<> get() const {
+        return handle;
+    }
+
+private:
+
+    explicit psm_task_t(std::coroutine_handle<promise_type> handle_) : handle(handle_) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// The part of an executor that waits need: suspended machines by id, the
+// queue of those ready to resume, and the psm_input_t sources they wait on. A
+// wake is matched to the wait it was meant for by the machine's wait
+// generation, so stale wakes are ignored.
+//
+// Inputs are the same psm_input_t a psm_deadline_scheduler_t subscribes
+// members to, compared by epoch the same way, so a machine reads and waits on
+// one input whichever runs it. Each run() readies the machines waiting on an
+// input whose epoch has moved on since they began waiting.
+class psm_waiters_t {
+public:
+    explicit psm_waiters_t(size_t max_machines)
+        : suspended(max_machines)
+        , generations(max_machines)
+    {}
+
+    [[nodiscard]] uint32_t generation(size_t id) const {
+        return generations[id];
+    }
+
+    // Readies machine   id   if it is still in the wait   generation   names.
+    // Ids of no machine are ignored.
+    void wake(size_t id, uint32_t generation) {
+        if (id < suspended.size() && generations[id] == generation && suspended[id]) {
+            ready.push_back(std::exchange(suspended[id], {}));
+            ++generations[id];
+        }
+    }
+
+    void wake(size_t id) {
+        if (id < generations.size()) {
+            wake(id, generations[id]);
+        }
+    }
+
+    // Readies machine   id   , if it is still in the wait   generation
+    // names, at the next change to   input   .
+    void watch(const psm_input_source_t& input, size_t id, uint32_t generation) {
+        subscription_t *subscription = nullptr;
+        for (auto& s : subscriptions) {
+            if (s.input == &input) {
+                subscription = &s;
+            }
+        }
+        if (!subscription) {
+            subscription = &subscriptions.emplace_back(subscription_t{ &input, input.epoch(), {} });
+        }
+        wake_watchers(*subscription); // A change before this wait is for the waits before it
+        auto& watchers = subscription->watchers;
+        if (watchers.size() == watchers.capacity()) {
+            std::erase_if(watchers, [&] (const auto& w) { return generations[w.first] != w.second; }); // Keep waits that ended early from piling up
+        }
+        watchers.emplace_back(id, generation);
+    }
+
+protected:
+
+    // Readies the machines waiting on every input that has changed.
+    void wake_watchers() {
+        for (auto& subscription : subscriptions) {
+            wake_watchers(subscription);
+        }
+    }
+
+    std::vector<std::coroutine_handle<>> suspended;
+    std::vector<uint32_t>                generations;
+    std::vector<std::coroutine_handle<>> ready;
+
+private:
+
+    struct subscription_t {
+        const psm_input_source_t                *input;
+        uint32_t                                 seen_epoch;
+        std::vector<std::pair<size_t, uint32_t>> watchers; // Machine ids and their wait generations
+    };
+
+    void wake_watchers(subscription_t& subscription) {
+        const uint32_t epoch = subscription.input->epoch();
+        if (epoch != subscription.seen_epoch) {
+            subscription.seen_epoch = epoch;
+            for (const auto& [id, generation] : subscription.watchers) {
+                wake(id, generation);
+            }
+            subscription.watchers.clear();
+        }
+    }
+
+    std::vector<subscription_t> subscriptions;
+};
+
+template <typename ms_t>
+class psm_executor_t : public psm_waiters_t {
+public:
+    psm_executor_t(size_t max_machines, ms_t now)
+        : psm_waiters_t(max_machines)
+        , wheel(max_machines, now)
+    {}
+
+    // Adds a machine, to be resumed at   start   by the next run(), setting
+    // id   to its id. Returns false if there's no room for it, as there's only
+    // room for the   max_machines   the executor was made with.
+    [[nodiscard]] bool add(std::coroutine_handle<> start, size_t& id) {
+        if (num_machines == suspended.size()) {
+            return false;
+        }
+        id = num_machines++;
+        ready.push_back(start);
+        return true;
+    }
+
+    // Suspends machine   id   until   deadline   , if it has one, or a wake().
+    void suspend(size_t id, std::coroutine_handle<> resume, const ms_t *deadline) {
+        suspended[id] = resume;
+        if (deadline) {
+            wheel.schedule(id, *deadline);
+        }
+        else {
+            wheel.cancel(id);
+        }
+    }
+
+    // Call 1/ms: resumes every machine whose deadline has arrived or that an
+    // input change or wake() has readied, until none are left ready. Inputs
+    // set while they run are seen before run() returns.
+    void run(ms_t now) {
+        wheel.advance(now, [&] (size_t id) {
+            wake(id);
+        });
+
+        for (wake_watchers(); !ready.empty(); wake_watchers()) {
+            std::swap(resuming, ready);
+            for (auto handle : resuming) {
+                handle.resume();
+            }
+            resuming.clear();
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return num_machines;
+    }
+
+private:
+
+    psm_timer_wheel_t<ms_t>              wheel;
+    std::vector<std::coroutine_handle<>> resuming;
+    size_t                               num_machines = 0;
+};
+
+template <typename derived_t, typename ms_t = size_t>
+class psm_co_machine_t {
+public:
+    using executor_t = psm_executor_t<ms_t>;
+
+    explicit psm_co_machine_t(executor_t& executor_) : executor(executor_) {}
+
+    psm_co_machine_t(const psm_co_machine_t&) = delete;
+    psm_co_machine_t& operator=(const psm_co_machine_t&) = delete;
+
+    // Creates the machine's actions() coroutine and adds it to the executor,
+    // returning false, and leaving the machine stopped, if the executor is
+    // full.
+    [[nodiscard]] bool start() {
+        derived_t& sm = static_cast<derived_t&>(*this);
+
+        psm_task_t actions = sm.actions(&sm.state, &sm.next_state);
+        if (!executor.add(actions.get(), id)) {
+            return false;
+        }
+        runner = std::move(actions);
+        return true;
+    }
+
+    // Call after delivering an event that changes next_state.
+    void wake() {
+        executor.wake(id);
+    }
+
+protected:
+
+    template <typename... inputs_t>
+    class wait_t {
+    public:
+        wait_t(psm_co_machine_t& sm_, const ms_t *deadline_, inputs_t&... inputs_)
+            : sm(sm_)
+            , deadline(deadline_ ? *deadline_ : ms_t{})
+            , has_deadline(deadline_ != nullptr)
+            , inputs(inputs_...)
+        {}
+
+        bool await_ready() const { return false; }
+        void await_resume() const {}
+        void await_suspend(std::coroutine_handle<> resume) {
+            const uint32_t generation = sm.executor.generation(sm.id);
+            std::apply([&] (auto&... input) { (sm.executor.watch(input, sm.id, generation), ...); }, inputs);
+            sm.executor.suspend(sm.id, resume, has_deadline ? &deadline : nullptr);
+        }
+
+    private:
+        psm_co_machine_t&        sm;
+        ms_t                     deadline;
+        bool                     has_deadline;
+        std::tuple<inputs_t&...> inputs;
+    };
+
+    // Starts a poll: the first pass, or the first after a park. Returns the
+    // pass's   psm_prev_state   . See PSM_CO_PASSES.
+    [[nodiscard]] auto begin_poll() {
+        derived_t& sm = static_cast<derived_t&>(*this);
+
+        poll_generation = executor.generation(id);
+        return psm_profile_poll_begin(&sm.state);
+    }
+
+    // Ends a pass: moves to next_state, and if that's no change and nothing
+    // woke the machine during the pass, parks it until something does.
+    // Resumes with the next pass's   psm_prev_state   .
+    template <typename state_t>
+    class end_of_pass_t {
+    public:
+        end_of_pass_t(psm_co_machine_t& sm_, state_t prev_state_)
+            : sm(sm_)
+            , prev_state(prev_state_)
+        {}
+
+        bool await_ready() {
+            derived_t& machine = static_cast<derived_t&>(sm);
+
+            psm_profile_iteration(machine, prev_state, machine.state, machine.next_state);
+            prev_state    = machine.state;
+            machine.state = machine.next_state;
+            if (prev_state != machine.next_state) {
+                return true; // On to the next pass
+            }
+            psm_profile_poll_end(prev_state);
+
+            if (sm.executor.generation(sm.id) != sm.poll_generation) { // Woken during the pass
+                prev_state = sm.begin_poll();
+                return true;
+            }
+            return false; // Nothing awaited and nothing changed: park until woken
+        }
+        void await_suspend(std::coroutine_handle<> resume) {
+            parked = true;
+            sm.executor.suspend(sm.id, resume, nullptr);
+        }
+        state_t await_resume() {
+            return parked ? sm.begin_poll() : prev_state;
+        }
+
+    private:
+        psm_co_machine_t& sm;
+        state_t           prev_state;
+        bool              parked = false;
+    };
+
+    template <typename state_t>
+    [[nodiscard]] end_of_pass_t<state_t> end_of_pass(state_t prev_state) {
+        return end_of_pass_t<state_t>(*this, prev_state);
+    }
+
+    // co_await these from actions(); each input is a psm_input_t.
+    template <typename... inputs_t>
+    [[nodiscard]] wait_t<inputs_t...> wait_until(ms_t deadline, inputs_t&... inputs) {
+        return wait_t<inputs_t...>(*this, &deadline, inputs...);
+    }
+
+    template <typename... inputs_t>
+    [[nodiscard]] wait_t<inputs_t...> wait_for(inputs_t&... inputs) {
+        return wait_t<inputs_t...>(*this, nullptr, inputs...);
+    }
+
+private:
+
+    executor_t& executor;
+    psm_task_t  runner;
+    size_t      id              = SIZE_MAX; // None until start()ed
+    uint32_t    poll_generation = 0;        // The executor's generation for id when the poll began
+};
+
+// The parameters of a psm_co_machine_t's actions(): PSM_ACTIONS_PARAMS, less
+// psm_prev_state   , which PSM_CO_PASSES declares afresh for every pass.
+#define PSM_CO_ACTIONS_PARAMS state_t *psm_state, state_t *psm_next_state
+
+// Wrap the body of a psm_co_machine_t's actions() in this as though it were a
+// for loop; it runs once per pass, forever.
+#define PSM_CO_PASSES for (auto psm_prev_state = begin_poll(); ; psm_prev_state = co_await end_of_pass(psm_prev_state))
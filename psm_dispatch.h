@@ -0,0 +1,58 @@
+#pragma once
+
+#include "X_macro_helpers.h"
+
+// Profile-guided dispatch: lays out a machine's   switch (state)   and guards
+// by how often they actually run rather than by the order they're written in.
+//
+//  1. Build the machine with a psm_state_profiler_t (see psm_profile.h), run a
+//     representative load, and write the counters out with
+//     export_dispatch_profile().
+//
+//  2. Turn them into a header of hints:
+//
+//        dispatch_gen TRAFFIC_LIGHT profile.txt > traffic_light_dispatch.h
+//
+//     which defines, for each state, TRAFFIC_LIGHT_DISPATCH_<state> as
+//     PSM_HOT (a quarter or more of all passes through the actions),
+//     PSM_COLD (under 1%) or PSM_WARM; TRAFFIC_LIGHT_HOT_STATES(X), the hot
+//     states, hottest first; and TRAFFIC_LIGHT_TRANSITIONS_RARE, 1 if under 1%
+//     of passes changed state.
+//
+//  3. Build with that header included, with the cases labelled
+//
+//        PSM_PROFILED_CASE(TRAFFIC_LIGHT, red):
+//
+//     instead of   case state_t::red:   , and the switch preceded by
+//
+//        PSM_DISPATCH_HOT_STATES(TRAFFIC_LIGHT)
+//
+//     Hot states are then tested for first, each with one compare and a
+//     direct branch, before the rest go through the switch's jump table. Cold
+//     states' code moves out of line, off the cache lines the hot path uses:
+//     to the end of the function, or for a function that isn't inline (GCC
+//     doesn't split those), into a separate .text.unlikely part. Guards can
+//     test TRAFFIC_LIGHT_TRANSITIONS_RARE to check first for the common case
+//     of none of them firing.
+//
+// The hints only move code around; a machine behaves the same with or without
+// them, or with a profile of a different load.
+
+// GCC predicts any path that calls a cold function is never taken and lays it
+// out after everything else, which [[unlikely]] alone doesn't. Costs a call on
+// the cold path.
+[[gnu::cold, gnu::noinline]] inline void psm_cold_path() {
+    asm(""); // So the call isn't optimized away
+}
+
+#define PSM_HOT  [[likely]]
+#define PSM_WARM
+#define PSM_COLD psm_cold_path();
+
+// Also defines the label   psm_case_<STATE>   for the hot state fast paths.
+#define PSM_PROFILED_CASE(PREFIX, STATE) \
+    case state_t::STATE: M_CONCAT(PREFIX, M_CONCAT(_DISPATCH_, STATE)) [[maybe_unused]] M_CONCAT(psm_case_, STATE)
+
+#define PSM_DISPATCH_HOT_STATES(PREFIX) M_CONCAT(PREFIX, _HOT_STATES)(PSM_HOT_STATE_FAST_PATH_)
+
+#define PSM_HOT_STATE_FAST_PATH_(STATE) if (state == state_t::STATE) [[likely]] { goto M_CONCAT(psm_case_, STATE); }
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "psm_trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// A fleet holds many instances of one polling state machine class as a
+// structure of arrays: every instance's   state   ,   next_state   and
+// state_entered_ms   live in three separate contiguous arrays instead of in one
+// object per instance.
+//
+// poll() makes a single pass over those arrays. For each instance it loads the
+// fields into a local machine_t, runs that machine's own poll() (and so its
+// PSM_DO_ACTIONS entry/do/exit loop, unchanged), and stores the fields back.
+// Once machine_t::poll() is inlined the local copy lives in registers, so the
+// pass streams through the arrays the way a hand-written batch loop would.
+//
+// If machine_t keeps an image of its outputs (see PSM_DECLARE_OUTPUTS() in
+// psm_output_port.h), a fourth array holds each member's, so members' outputs
+// are their own; machine_t::poll() writes out the ones it changed, through
+// its static   write_outputs(image, changed)   , which write_outputs() also
+// uses.
+//
+// If machine_t also has static   guarded_states()   and   now()   , poll() skips
+// members whose poll would do nothing. guarded_states() returns a bit per
+// state (states 0 to 31 only) in which the guards every state shares, such as
+// a common IF_DO block testing global inputs, would change   next_state   with
+// the inputs as they are now. Before polling each block of 64 members, a
+// pre-pass marks the ones that are in such a state, have a transition pending
+// (state != next_state, as after an event), or have reached the deadline
+// their last poll() returned, which another array holds; only those are
+// loaded and polled. Members still   unset   (state 0), as added ones are,
+// are always polled, whatever the time, since they've never returned a
+// deadline. It's AVX2 or SSE2 when the compiler targets either,
+// scalar otherwise. The result is the same as polling every member, just
+// without the polls that would have found nothing to do.
+//
+// Trace records logged while polling or visiting a member are tagged with its
+// index (see psm_trace.h).
+//
+// machine_t must be default constructible, must hold no per-instance data other
+// than those three fields (and the ones PSM_DECLARE_TRANSITION_BUDGET() and
+// PSM_DECLARE_OUTPUTS() add, which get arrays of their own), and, if they are
+// private, must declare
+//
+//     template <typename> friend class psm_fleet_t;
+//
+template <typename machine_t>
+class psm_fleet_t {
+public:
+    using state_t = decltype(machine_t::state);
+    using ms_t    = decltype(machine_t::state_entered_ms);
+
+    static constexpr bool has_budget = requires { machine_t::psm_max_passes_per_poll; };
+    static constexpr bool has_guards  = requires { { machine_t::guarded_states() } -> std::same_as<uint32_t>; machine_t::now(); };
+    static constexpr bool has_outputs = requires (machine_t sm) { sm.psm_outputs; };
+
+    // The type of machine_t's psm_outputs, or a placeholder for machines with no outputs.
+    using outputs_t = decltype([] { if constexpr (has_outputs) { return machine_t{}.psm_outputs; } else { return false; } }());
+
+    explicit psm_fleet_t(size_t size)
+        : state(size)
+        , next_state(size)
+        , state_entered_ms(size)
+        , carried_prev_state(has_budget ? size : 0)
+        , wake_ms(has_guards ? size : 0)
+        , outputs(has_outputs ? size : 0)
+    {}
+
+    [[nodiscard]] size_t size() const {
+        return state.size();
+    }
+
+    // Members added start out as default constructed ones do, unset.
+    void resize(size_t size) {
+        state           .resize(size);
+        next_state      .resize(size);
+        state_entered_ms.resize(size);
+        if constexpr (has_budget) {
+            carried_prev_state.resize(size);
+        }
+        if constexpr (has_guards) {
+            wake_ms.resize(size);
+        }
+        if constexpr (has_outputs) {
+            outputs.resize(size);
+        }
+    }
+
+    // Returns how many members it actually polled, which the guard pre-pass
+    // can make fewer than size().
+    size_t poll() { // Call 1/ms
+        return poll(0, size());
+    }
+
+    // Polls instances   [begin, end)   , for callers that split the fleet into
+    // shards.
+    [[gnu::flatten]] size_t poll(size_t begin, size_t end) { // Inline machine_t::poll() into the pass
+        if constexpr (has_guards) {
+            const uint32_t guarded   = machine_t::guarded_states() | 1; // Unset members have yet to start
+            const ms_t     now       = (ms_t)machine_t::now();
+            size_t         num_polled = 0;
+            for (size_t block = begin; block < end; block += 64) {
+                uint64_t due = due_mask(block, std::min<size_t>(end - block, 64), guarded, now);
+                num_polled += std::popcount(due);
+                for (; due; due &= due - 1) {
+                    poll_one(block + std::countr_zero(due));
+                }
+            }
+            return num_polled;
+        }
+        else {
+            for (size_t i = begin; i < end; ++i) {
+                poll_one(i);
+            }
+            return end - begin;
+        }
+    }
+
+    // Polls only instance   i   , returning whatever its poll() returns.
+    auto poll(size_t i) {
+        return poll_one(i);
+    }
+
+    // Writes out every member's outputs that are on, tagging trace records
+    // with the member, as for a fleet whose images were restored (see
+    // psm_restore_snapshot()) while the outputs themselves are all off.
+    void write_outputs() requires has_outputs {
+        for (size_t i = 0; i < size(); ++i) {
+            psm_trace_machine = (uint32_t)i;
+            outputs[i].flush_since(outputs_t{}, machine_t::write_outputs);
+        }
+    }
+
+    // Runs   f(machine_t&)   on instance   i   , for delivering events such as
+    // handle_error_event() to one member of the fleet.
+    template <typename F>
+    void visit(size_t i, F&& f) {
+        psm_trace_machine = (uint32_t)i;
+        machine_t sm = load(i);
+        f(sm);
+        store(i, sm);
+    }
+
+    // Data members
+
+    std::vector<state_t> state;
+    std::vector<state_t> next_state;
+    std::vector<ms_t>    state_entered_ms;
+    std::vector<state_t> carried_prev_state; // Only for machines with a PSM_DECLARE_TRANSITION_BUDGET()
+    std::vector<ms_t>    wake_ms;            // Only for machines with guarded_states()
+    std::vector<outputs_t> outputs;          // Only for machines with PSM_DECLARE_OUTPUTS()
+
+private:
+
+    static_assert(!has_guards || sizeof(ms_t) == sizeof(uint32_t), "the guard pre-pass needs 32-bit state_entered_ms");
+
+    auto poll_one(size_t i) {
+        psm_trace_machine = (uint32_t)i;
+        machine_t sm = load(i);
+        auto result = sm.poll();
+        store(i, sm);
+        if constexpr (has_guards) {
+            wake_ms[i] = (ms_t)result;
+        }
+        return result;
+    }
+
+    [[nodiscard]] bool is_due(size_t i, uint32_t guarded, ms_t now) const {
+        const auto s = (size_t)state[i];
+        return state[i] != next_state[i]
+            || (s < 32 && (guarded >> s & 1))
+            || (int32_t)(now - wake_ms[i]) >= 0;
+    }
+
+    // Bit j is set if member   block + j   needs polling, for j < n <= 64.
+    [[nodiscard]] uint64_t due_mask(size_t block, size_t n, uint32_t guarded, ms_t now) const {
+        uint64_t due = 0;
+        size_t   j   = 0;
+
+#if defined(__SSE2__)
+        if constexpr (sizeof(state_t) == 1) {
+            const uint8_t *states      = (const uint8_t *)&state[block];
+            const uint8_t *next_states = (const uint8_t *)&next_state[block];
+            const ms_t    *wakes       = &wake_ms[block];
+
+#if defined(__AVX2__)
+            const __m256i now_v     = _mm256_set1_epi32((int)now);
+            const __m256i guarded_v = _mm256_set1_epi32((int)guarded);
+            const __m256i ones      = _mm256_set1_epi32(-1);
+            for (; j + 8 <= n; j += 8) {
+                const __m256i s       = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(states + j)));
+                const __m256i next    = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(next_states + j)));
+                const __m256i wake    = _mm256_loadu_si256((const __m256i *)(wakes + j));
+                const __m256i pending = _mm256_xor_si256(_mm256_cmpeq_epi32(s, next), ones);
+                const __m256i reached = _mm256_cmpgt_epi32(_mm256_sub_epi32(now_v, wake), ones);
+                const __m256i guard   = _mm256_slli_epi32(_mm256_srlv_epi32(guarded_v, s), 31); // Shifts of 32 or more give 0
+                const __m256i any     = _mm256_or_si256(_mm256_or_si256(pending, reached), guard);
+                due |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(any)) << j;
+            }
+#else
+            const __m128i now_v = _mm_set1_epi32((int)now);
+            const __m128i ones  = _mm_set1_epi32(-1);
+            const __m128i zero  = _mm_setzero_si128();
+            const auto widen = [&] (const uint8_t *p) {
+                int32_t bytes;
+                __builtin_memcpy(&bytes, p, sizeof(bytes));
+                return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+            };
+            for (; j + 4 <= n; j += 4) {
+                const __m128i s    = widen(states + j);
+                const __m128i next = widen(next_states + j);
+                const __m128i wake = _mm_loadu_si128((const __m128i *)(wakes + j));
+                __m128i any = _mm_or_si128(
+                    _mm_xor_si128(_mm_cmpeq_epi32(s, next), ones),
+                    _mm_cmpgt_epi32(_mm_sub_epi32(now_v, wake), ones));
+                for (uint32_t g = guarded; g; g &= g - 1) { // No variable shifts: compare with each guarded state
+                    any = _mm_or_si128(any, _mm_cmpeq_epi32(s, _mm_set1_epi32(std::countr_zero(g))));
+                }
+                due |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(any)) << j;
+            }
+#endif
+        }
+#endif
+
+        for (; j < n; ++j) {
+            due |= (uint64_t)is_due(block + j, guarded, now) << j;
+        }
+        return due;
+    }
+
+    [[nodiscard]] machine_t load(size_t i) const {
+        machine_t sm;
+        sm.state            = state[i];
+        sm.next_state       = next_state[i];
+        sm.state_entered_ms = state_entered_ms[i];
+        if constexpr (has_budget) {
+            sm.psm_carried_prev_state = carried_prev_state[i];
+        }
+        if constexpr (has_outputs) {
+            sm.psm_outputs = outputs[i];
+        }
+        return sm;
+    }
+
+    void store(size_t i, const machine_t& sm) {
+        state[i]            = sm.state;
+        next_state[i]       = sm.next_state;
+        state_entered_ms[i] = sm.state_entered_ms;
+        if constexpr (has_budget) {
+            carried_prev_state[i] = sm.psm_carried_prev_state;
+        }
+        if constexpr (has_outputs) {
+            outputs[i] = sm.psm_outputs;
+        }
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Text formatting into a fixed-size buffer, for diagnostics on targets with
+// no heap and no iostreams. Streams like an ostream, but only what log lines
+// need: strings, characters, integers, and a minimum width for the next item,
+// padded on the left as with std::setw().
+//
+//    psm_format_buffer_t<80> line;
+//    line << psm_setw(5) << now_ms << " state: " << name << "\n";
+//    uart_write(line.data(), line.size());
+//
+// Nothing allocates and nothing throws. Text that doesn't fit is cut off and
+// truncated() says so; the buffer keeps what fitted.
+
+struct psm_width_t {
+    size_t width;
+};
+
+[[nodiscard]] constexpr psm_width_t psm_setw(size_t width) {
+    return { width };
+}
+
+template <size_t capacity>
+class psm_format_buffer_t {
+public:
+    psm_format_buffer_t& operator<<(const char *text) {
+        size_t length = 0;
+        while (text[length]) {
+            ++length;
+        }
+        return append(text, length);
+    }
+
+    psm_format_buffer_t& operator<<(char c) {
+        return append(&c, 1);
+    }
+
+    template <typename int_t>
+        requires std::is_integral_v<int_t>
+    psm_format_buffer_t& operator<<(int_t value) {
+        char  digits[24]; // Enough for any 64-bit value and its sign
+        char *p = digits + sizeof(digits);
+
+        // Negated as unsigned so the most negative value needs no special case.
+        const bool         negative  = std::is_signed_v<int_t> && value < 0;
+        unsigned long long magnitude = negative ? 0ull - (unsigned long long)value : (unsigned long long)value;
+        do {
+            *--p = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (negative) {
+            *--p = '-';
+        }
+        return append(p, digits + sizeof(digits) - p);
+    }
+
+    psm_format_buffer_t& operator<<(bool value) {
+        return *this << (unsigned)value;
+    }
+
+    psm_format_buffer_t& operator<<(psm_width_t width) {
+        next_width = width.width;
+        return *this;
+    }
+
+    [[nodiscard]] const char *data() const {
+        return text;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+
+    [[nodiscard]] bool truncated() const {
+        return overflowed;
+    }
+
+    void clear() {
+        length     = 0;
+        next_width = 0;
+        overflowed = false;
+    }
+
+private:
+
+    psm_format_buffer_t& append(const char *chars, size_t count) {
+        for (; next_width > count; --next_width) {
+            put(' ');
+        }
+        next_width = 0;
+        for (size_t i = 0; i < count; ++i) {
+            put(chars[i]);
+        }
+        return *this;
+    }
+
+    void put(char c) {
+        if (length < capacity) {
+            text[length++] = c;
+        }
+        else {
+            overflowed = true;
+        }
+    }
+
+    // Data members
+
+    char   text[capacity];
+    size_t length     = 0;
+    size_t next_width = 0;
+    bool   overflowed = false;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "psm_table.h"
+
+#include "X_macro_helpers.h"
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+// Hierarchical States
+// ===================
+//
+// Table dispatch (see psm_table.h) for machines whose states nest. The X
+// macro gets a parent column, naming   unset   for top level states, and lists
+// the states depth first, each parent before its children:
+//
+//    #define FOREACH_TRAFFIC_LIGHT_STATE(X) \.
+//        X(operating, unset)                \.
+//        X(red,       operating)            \.
+//        X(green,     operating)            \.
+//        X(flashing,  unset)                \.
+//
+//    struct traffic_light_t {
+//        enum class state_t { unset, FOREACH_TRAFFIC_LIGHT_STATE(DECLARE_FIRST) };
+//
+//        struct unset     { ... };
+//        struct operating {
+//            static void do_actions(traffic_light_t& sm) { if (fault) sm.next_state = state_t::flashing; }
+//        };
+//        struct red       { ... };
+//        ...
+//
+//        PSM_DECLARE_HIERARCHICAL_HANDLER_TABLE(traffic_light_t, FOREACH_TRAFFIC_LIGHT_STATE)
+//
+//        void poll() { psm_do_hierarchical_actions(*this, handler_table); }
+//
+//        PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+//    };
+//
+// A state's ancestors' actions run along with its own, in the usual order for
+// nested states:
+//
+//   - entry: those of the outermost ancestor not already entered (one not
+//     containing the state just left) first, down to the state's own;
+//
+//   - do: the outermost ancestor's first, down to the state's own, stopping
+//     as soon as one sets   next_state   , as for IF_DO blocks, so an ancestor
+//     can preempt its children;
+//
+//   - exit: the state's own first, out to those of the outermost ancestor
+//     not containing   next_state   , stopping if one sets   next_state
+//     back to   state   to cancel the transition.
+//
+// A parent can also be the active state itself, say as the target of a
+// transition; its do_actions() runs then too, and can check   sm.state   to
+// pick a child to go on to. Passes call the same profiling hooks as
+// psm_do_table_actions() does.
+//
+// The nesting is flattened at compile time: each state's table entry is a
+// single function per phase with its ancestors' actions inlined into it, and
+// whether an ancestor contains the state left or the state next is a range
+// check against constants, since depth first order gives every parent a
+// contiguous range of descendants. So a pass costs one indexed load and
+// call per phase, however deep the state is nested, and nothing at all for
+// a phase no state in the chain has an action for.
+
+template <size_t num_states>
+struct psm_hierarchy_t {
+    std::array<size_t, num_states> parent; // 0 (unset) for top level states
+    std::array<size_t, num_states> last;   // Each state's last descendant, or itself
+
+    constexpr explicit psm_hierarchy_t(const std::array<size_t, num_states>& parent_)
+        : parent(parent_)
+        , last{}
+    {
+        for (size_t i = 0; i < num_states; ++i) {
+            last[i] = i;
+        }
+        for (size_t i = num_states - 1; i > 0; --i) {
+            if (parent[i] != 0 && last[i] > last[parent[i]]) {
+                last[parent[i]] = last[i];
+            }
+        }
+    }
+
+    // True if each state's parent is the state before it or one of that
+    // state's ancestors, so each subtree is contiguous.
+    [[nodiscard]] constexpr bool is_depth_first() const {
+        for (size_t i = 1; i < num_states; ++i) {
+            bool found = parent[i] == 0;
+            for (size_t a = i - 1; a != 0 && !found; a = parent[a]) {
+                found = a == parent[i];
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool contains(size_t ancestor, size_t state) const {
+        return ancestor <= state && state <= last[ancestor];
+    }
+};
+
+template <typename sm_t, typename state_t>
+struct psm_hierarchical_handlers_t {
+    void (*entry     )(sm_t&, state_t prev_state);
+    void (*do_actions)(sm_t&);
+    void (*exit      )(sm_t&);
+};
+
+// The flattened actions of the state whose actions struct is   state_actions_t
+// and those of its ancestors.
+template <typename sm_t, typename state_actions_t>
+struct psm_flattened_actions_t {
+    using state_t          = typename sm_t::state_t;
+    using parent_actions_t = decltype(sm_t::psm_parent_of((state_actions_t *)nullptr));
+    using parent_t         = psm_flattened_actions_t<sm_t, parent_actions_t>;
+
+    static constexpr size_t index  = (size_t)sm_t::psm_state_of((state_actions_t *)nullptr);
+    static constexpr bool   is_top = std::is_same_v<parent_actions_t, typename sm_t::unset>; // Including unset itself
+
+    static constexpr bool has_own_entry = requires (sm_t& sm) { state_actions_t::entry(sm);      };
+    static constexpr bool has_own_do    = requires (sm_t& sm) { state_actions_t::do_actions(sm); };
+    static constexpr bool has_own_exit  = requires (sm_t& sm) { state_actions_t::exit(sm);       };
+
+    static constexpr bool has_entry() { if constexpr (is_top) { return has_own_entry; } else { return has_own_entry || parent_t::has_entry(); } }
+    static constexpr bool has_do()    { if constexpr (is_top) { return has_own_do;    } else { return has_own_do    || parent_t::has_do();    } }
+    static constexpr bool has_exit()  { if constexpr (is_top) { return has_own_exit;  } else { return has_own_exit  || parent_t::has_exit();  } }
+
+    static constexpr bool is_parent = sm_t::hierarchy.last[index] != index;
+
+    // Each level runs only if the state left (or next) is outside it; for a
+    // parent that's active itself, that's checked here, for ancestors by the
+    // child.
+
+    static void entry(sm_t& sm, state_t prev_state) {
+        if constexpr (is_parent) {
+            if (sm_t::hierarchy.contains(index, (size_t)prev_state)) {
+                return; // Back from a child
+            }
+        }
+        if constexpr (!is_top) {
+            if (!sm_t::hierarchy.contains(parent_t::index, (size_t)prev_state)) {
+                parent_t::entry(sm, prev_state);
+            }
+        }
+        if constexpr (has_own_entry) {
+            state_actions_t::entry(sm);
+        }
+    }
+
+    static void do_actions(sm_t& sm) {
+        if constexpr (!is_top) {
+            parent_t::do_actions(sm);
+            if (sm.state != sm.next_state) {
+                return; // An ancestor preempted this state
+            }
+        }
+        if constexpr (has_own_do) {
+            state_actions_t::do_actions(sm);
+        }
+    }
+
+    static void exit(sm_t& sm) {
+        if constexpr (is_parent) {
+            if (sm_t::hierarchy.contains(index, (size_t)sm.next_state)) {
+                return; // On to a child
+            }
+        }
+        if constexpr (has_own_exit) {
+            state_actions_t::exit(sm);
+            if (sm.state == sm.next_state) {
+                return; // Cancelled
+            }
+        }
+        if constexpr (!is_top) {
+            if (!sm_t::hierarchy.contains(parent_t::index, (size_t)sm.next_state)) {
+                parent_t::exit(sm);
+            }
+        }
+    }
+
+    static constexpr psm_hierarchical_handlers_t<sm_t, state_t> handlers() {
+        psm_hierarchical_handlers_t<sm_t, state_t> handlers{};
+        if constexpr (has_entry()) { handlers.entry      = &entry;      }
+        if constexpr (has_do()   ) { handlers.do_actions = &do_actions; }
+        if constexpr (has_exit() ) { handlers.exit       = &exit;       }
+        return handlers;
+    }
+};
+
+template <typename sm_t, typename state_t, size_t num_states>
+using psm_hierarchical_handler_table_t = std::array<psm_hierarchical_handlers_t<sm_t, state_t>, num_states>;
+
+#define PSM_DECLARE_PARENT_INDEX_(STATE, PARENT)       (size_t)state_t::PARENT,
+#define PSM_DECLARE_PARENT_OF_(STATE, PARENT)          static PARENT psm_parent_of(STATE *);                                      \
+                                                       static constexpr state_t psm_state_of(STATE *) { return state_t::STATE; }  \
+
+#define PSM_DECLARE_FLATTENED_HANDLERS_(STATE, PARENT) psm_flattened_actions_t<psm_sm_t, STATE>::handlers(),
+
+// Place in the machine's class after the per-state structs (including
+// unset   ). Declares   hierarchy   and   handler_table   .
+#define PSM_DECLARE_HIERARCHICAL_HANDLER_TABLE(sm_t, FOREACH_STATE)                                                   \
+    using psm_sm_t = sm_t;                                                                                            \
+    static unset psm_parent_of(unset *);                                                                              \
+    static constexpr state_t psm_state_of(unset *) { return state_t::unset; }                                         \
+    FOREACH_STATE(PSM_DECLARE_PARENT_OF_)                                                                             \
+    static constexpr psm_hierarchy_t<M_NUM_DECLS_IN(FOREACH_STATE) + 1> hierarchy{{{                                 \
+        0,                                                                                                            \
+        FOREACH_STATE(PSM_DECLARE_PARENT_INDEX_)                                                                      \
+    }}};                                                                                                              \
+    static_assert(hierarchy.is_depth_first(), "states must be listed depth first, each parent before its children"); \
+    static constexpr psm_hierarchical_handler_table_t<sm_t, state_t, M_NUM_DECLS_IN(FOREACH_STATE) + 1>               \
+        handler_table = {{                                                                                            \
+            psm_flattened_actions_t<sm_t, unset>::handlers(),                                                         \
+            FOREACH_STATE(PSM_DECLARE_FLATTENED_HANDLERS_)                                                            \
+        }};                                                                                                           \
+
+// The hierarchical equivalent of psm_do_table_actions().
+template <typename sm_t, typename state_t, size_t num_states>
+inline void psm_do_hierarchical_actions(sm_t& sm, const psm_hierarchical_handler_table_t<sm_t, state_t, num_states>& table) {
+    auto prev_state = psm_profile_poll_begin(&sm.state);
+    while (true) {
+        const psm_hierarchical_handlers_t<sm_t, state_t>& handlers = table[(size_t)sm.state];
+
+        if (sm.state != prev_state      && handlers.entry                                          ) { handlers.entry(sm, prev_state); }
+        if (sm.state == sm.next_state   && handlers.do_actions                                     ) { handlers.do_actions(sm);        }
+        if (sm.state != sm.next_state   && handlers.exit && psm_profile_exit_block(&sm.state)      ) { handlers.exit(sm);              }
+        psm_profile_iteration(sm, prev_state, sm.state, sm.next_state);
+
+        prev_state = sm.state;
+        sm.state   = sm.next_state;
+        if (prev_state == sm.next_state) {
+            psm_profile_poll_end(prev_state);
+            break; // No change
+        }
+    }
+}
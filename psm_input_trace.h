@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Recording and replay of the inputs that drive polling state machines, for
+// reproducing an incident against the exact sequence of inputs that caused it.
+//
+// A recording is a flat file of fixed-size records, one per input change, in
+// time order. Applications number their inputs (flags the machines poll and
+// events delivered to them) from 0 up to, but not including,
+// PSM_INPUT_END; psm_input_recorder_t::close() writes a final PSM_INPUT_END
+// record to mark when the recorded run stopped.
+//
+// psm_input_replay_t maps a recording read-only so a replayer can walk it
+// with no reads or copies. Since machines only change what they do when an
+// input changes or a deadline they returned from poll() passes, a replayer
+// needs to poll only at those times, not every tick.
+
+enum : uint8_t {
+    PSM_INPUT_END = 0xff, // Marks the end of a recording
+};
+
+struct psm_input_record_t {
+    uint64_t ms    : 48;
+    uint64_t input : 8;
+    uint64_t value : 8; // Input-specific, e.g. a flag's new value
+};
+
+static_assert(sizeof(psm_input_record_t) == 8, "input records are written to files as-is");
+
+class psm_input_recorder_t {
+public:
+
+    psm_input_recorder_t() = default;
+    psm_input_recorder_t(const psm_input_recorder_t&) = delete;
+    psm_input_recorder_t& operator=(const psm_input_recorder_t&) = delete;
+
+    ~psm_input_recorder_t() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    // Starts a new recording; returns false with errno set on failure.
+    [[nodiscard]] bool open(const char *path) {
+        file = fopen(path, "wb");
+        return file != nullptr;
+    }
+
+    [[nodiscard]] bool is_open() const {
+        return file != nullptr;
+    }
+
+    void record(size_t ms, uint8_t input, uint8_t value) {
+        psm_input_record_t record{};
+        record.ms    = ms;
+        record.input = input;
+        record.value = value;
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    // Ends the recording at   ms  ; returns false if any write failed.
+    bool close(size_t ms) {
+        record(ms, PSM_INPUT_END, 0);
+        const bool ok = !ferror(file);
+        fclose(file);
+        file = nullptr;
+        return ok;
+    }
+
+private:
+
+    FILE *file = nullptr;
+};
+
+class psm_input_replay_t {
+public:
+
+    psm_input_replay_t() = default;
+    psm_input_replay_t(const psm_input_replay_t&) = delete;
+    psm_input_replay_t& operator=(const psm_input_replay_t&) = delete;
+
+    ~psm_input_replay_t() {
+        if (records) {
+            munmap((void *)records, num_records * sizeof(psm_input_record_t));
+        }
+    }
+
+    // Maps a recording; returns false with errno set on failure, EINVAL if
+    // it's empty or not a whole number of records, as when the recorder was
+    // cut off mid-write.
+    [[nodiscard]] bool open(const char *path) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && (st.st_size == 0 || st.st_size % sizeof(psm_input_record_t) != 0)) {
+            errno = EINVAL;
+            ok    = false;
+        }
+        if (ok) {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = p != MAP_FAILED;
+            if (ok) {
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                records     = (const psm_input_record_t *)p;
+                num_records = st.st_size / sizeof(psm_input_record_t);
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    [[nodiscard]] const psm_input_record_t *begin() const { return records; }
+    [[nodiscard]] const psm_input_record_t *end()   const { return records + num_records; }
+    [[nodiscard]] size_t                    size()  const { return num_records; }
+
+private:
+
+    const psm_input_record_t *records     = nullptr;
+    size_t                    num_records = 0;
+};
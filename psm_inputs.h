@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+// Declared input sources: a value the machines read, such as a sensor flag,
+// that counts its changes in an epoch. Something that needs to know whether
+// the input changed since it last looked (psm_deadline_scheduler_t, deciding
+// whom to wake, or psm_executor_t, deciding which coroutines waiting on it to
+// resume) compares epochs instead of values or change flags, so any number of
+// observers can each look at their own pace without resetting anything the
+// others rely on.
+//
+// Machines read an input just as they would the plain variable it replaces:
+//
+//    inline psm_input_t<bool> door_open;
+//    ...
+//    IF_DO { if (door_open) { ... } }
+//
+// and whatever samples the hardware calls set(), which bumps the epoch only
+// when the value actually changes.
+
+class psm_input_source_t {
+public:
+    [[nodiscard]] uint32_t epoch() const {
+        return change_epoch;
+    }
+
+protected:
+
+    uint32_t change_epoch = 0;
+};
+
+template <typename value_t>
+class psm_input_t : public psm_input_source_t {
+public:
+    explicit psm_input_t(value_t value_ = {}) : value(value_) {}
+
+    psm_input_t(const psm_input_t&) = delete;
+    psm_input_t& operator=(const psm_input_t&) = delete;
+
+    [[nodiscard]] const value_t& get() const {
+        return value;
+    }
+
+    operator const value_t&() const {
+        return value;
+    }
+
+    // Returns whether the value changed.
+    bool set(const value_t& new_value) {
+        if (new_value == value) {
+            return false;
+        }
+        value = new_value;
+        ++change_epoch;
+        return true;
+    }
+
+private:
+
+    value_t value;
+};
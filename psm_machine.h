@@ -0,0 +1,116 @@
+#pragma once
+
+#include "polling_state_machine.h"
+
+// A standard C++ alternative to PSM_DO_ACTIONS(), which needs GNU   typeof
+// and runs its loop increment in a lambda. Derive the machine from
+// psm_machine_t, put its action blocks in an   actions()   member declared
+// with PSM_ACTIONS_PARAMS, and call do_actions() from poll():
+//
+//    class traffic_light_t : public psm_machine_t<traffic_light_t> {
+//    public:
+//        void poll() { do_actions(); }
+//
+//    private:
+//        friend psm_machine_t;
+//
+//        void actions(PSM_ACTIONS_PARAMS) {
+//            switch (state) {
+//                case state_t::red:
+//                    IF_ENTRY { ... }
+//                    IF_DO    { ... }
+//                    IF_EXIT  { ... }
+//                    break;
+//                ...
+//            }
+//        }
+//
+//        enum class state_t { unset, FOREACH_TRAFFIC_LIGHT_STATE(DECLARE_NAME) };
+//
+//        PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+//    };
+//
+// IF_ENTRY, IF_DO and IF_EXIT work in actions() exactly as they do inside
+// PSM_DO_ACTIONS(), with the same rules, including exit cancellation, and the
+// same profiling hooks. Any arguments given to do_actions() are passed on to
+// actions() after the PSM_ACTIONS_PARAMS, so actions() can update the
+// caller's locals.
+//
+// The loop is a plain   while   around a call that inlines, so poll()
+// compiles to code at least as tight as the macro's; `make codegen_test`
+// checks that for stoplight_sm_t.
+//
+// Unlike PSM_DO_ACTIONS(), psm_machine_t can bound the work one poll does, for
+// machines whose chains of transitions must not overrun a tick. Declare
+//
+//        PSM_DECLARE_TRANSITION_BUDGET(state_t, max_passes)
+//
+// in the machine, and do_actions() stops after   max_passes   passes through
+// actions() even if the last one changed state, returning false. The next
+// poll picks up where it left off: it starts by running the new state's
+// IF_ENTRY blocks, so every state still sees entry, do and exit in order;
+// only the tick they happen on moves. Polls that run out of budget are
+// reported to the profiler.
+
+// Declares the budget and the field that remembers a pending entry between
+// polls. Put it before PSM_DECLARE_PACKED_STATE_MACHINE_FIELDS() to use that
+// layout's padding.
+#define PSM_DECLARE_TRANSITION_BUDGET(state_t, max_passes)                    \
+    static constexpr unsigned psm_max_passes_per_poll = (max_passes);         \
+    static_assert(psm_max_passes_per_poll > 0, "a poll must make one pass");  \
+    state_t psm_carried_prev_state{};                                         \
+
+// The parameters IF_ENTRY, IF_DO and IF_EXIT refer to. psm_state and
+// psm_next_state point at the machine's own fields.
+#define PSM_ACTIONS_PARAMS state_t psm_prev_state, state_t *psm_state, state_t *psm_next_state
+
+template <typename derived_t>
+class psm_machine_t {
+public:
+
+    // Lets machines default their own operator==
+    friend bool operator==(const psm_machine_t&, const psm_machine_t&) = default;
+
+protected:
+
+    // Returns false if the machine ran out of its transition budget and must
+    // be polled again on the next tick.
+    template <typename... args_t>
+    bool do_actions(args_t&&... args) {
+        derived_t& sm = static_cast<derived_t&>(*this);
+
+        auto prev_state = psm_profile_poll_begin(&sm.state);
+        if constexpr (has_budget) {
+            prev_state = sm.psm_carried_prev_state; // Differs from state if the last poll left its entry pending
+        }
+
+        [[maybe_unused]] unsigned num_passes = 0;
+        while (true) {
+            sm.actions(prev_state, &sm.state, &sm.next_state, args...);
+            psm_profile_iteration(sm, prev_state, sm.state, sm.next_state);
+
+            prev_state = sm.state;
+            sm.state   = sm.next_state;
+            if (prev_state == sm.next_state) {
+                if constexpr (has_budget) {
+                    sm.psm_carried_prev_state = sm.state;
+                }
+                psm_profile_poll_end(prev_state);
+                return true; // No change
+            }
+
+            if constexpr (has_budget) {
+                if (++num_passes >= derived_t::psm_max_passes_per_poll) {
+                    sm.psm_carried_prev_state = prev_state; // Enter sm.state next poll
+                    psm_profile_budget_exhausted(prev_state);
+                    psm_profile_poll_end(prev_state);
+                    return false;
+                }
+            }
+        }
+    }
+
+private:
+
+    static constexpr bool has_budget = requires { derived_t::psm_max_passes_per_poll; };
+};
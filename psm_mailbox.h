@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Mailboxes for delivering events to polling state machines from other threads
+// or interrupt handlers. Calling an event handler such as
+// stoplight_sm_t::handle_error_event() directly from there races with poll();
+// instead, producers post the event to a mailbox and the polling thread
+// drains it at the top of poll(), where handlers run as if called between
+// polls. Neither side ever takes a lock, and a full mailbox makes try_post()
+// return false rather than block, so an interrupt handler can never stall.
+//
+// Use psm_spsc_mailbox_t when each mailbox has a single producer (say, one
+// IRQ), and psm_mpsc_mailbox_t when several threads post to it. For fleets,
+// post psm_addressed_event_t to one mailbox per fleet or shard and deliver
+// with psm_deliver_events().
+
+// A single-producer, single-consumer ring (Lamport's queue). Both sides are
+// wait-free: each touches the other's index only when its cached copy says
+// the ring is full or empty.
+template <typename event_t, size_t capacity>
+class psm_spsc_mailbox_t {
+public:
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    using event_type = event_t;
+
+    bool try_post(const event_t& event) {
+        const size_t pos = tail.load(std::memory_order_relaxed);
+        if (pos - head_cache == capacity) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (pos - head_cache == capacity) {
+                return false; // Full
+            }
+        }
+        events[pos & (capacity - 1)] = event;
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(event_t& event) {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        if (pos == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (pos == tail_cache) {
+                return false; // Empty
+            }
+        }
+        event = events[pos & (capacity - 1)];
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+
+    event_t events[capacity];
+
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t                          head_cache = 0; // Producer's
+    alignas(64) std::atomic<size_t> head{0};
+    size_t                          tail_cache = 0; // Consumer's
+};
+
+// A bounded multi-producer, single-consumer ring (Vyukov's bounded queue, as
+// psm_trace_ring_t, minus the consumer-side CAS). A producer retries only when
+// another producer claims the same slot first, so some producer always
+// succeeds; the consumer is wait-free.
+template <typename event_t, size_t capacity>
+class psm_mpsc_mailbox_t {
+public:
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    using event_type = event_t;
+
+    psm_mpsc_mailbox_t() {
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_post(const event_t& event) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            cell_t& cell = cells[pos & (capacity - 1)];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.event = event;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false; // Full
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(event_t& event) {
+        cell_t& cell = cells[head & (capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false; // Empty, or the next event is still being posted
+        }
+        event = cell.event;
+        cell.sequence.store(head + capacity, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+private:
+
+    struct cell_t {
+        std::atomic<size_t> sequence;
+        event_t             event;
+    };
+
+    cell_t cells[capacity];
+
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t              head = 0; // Consumer's only
+};
+
+// An event for one member of a fleet.
+template <typename event_t>
+struct psm_addressed_event_t {
+    uint32_t machine;
+    event_t  event;
+};
+
+// Drains   mailbox   , handing each event to the fleet member it names with
+// machine_t::handle_event(), and returns how many there were. Call from the
+// polling thread just before polling the fleet.
+template <typename fleet_t, typename mailbox_t>
+size_t psm_deliver_events(fleet_t& fleet, mailbox_t& mailbox) {
+    size_t                         num_delivered = 0;
+    typename mailbox_t::event_type addressed;
+    while (mailbox.try_pop(addressed)) {
+        fleet.visit(addressed.machine, [&] (auto& sm) {
+            sm.handle_event(addressed.event);
+        });
+        ++num_delivered;
+    }
+    return num_delivered;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <unistd.h>
+
+// Proof that a program never touches the heap: replaces the C allocator with
+// one that reports the attempt on stderr and aborts. operator new, the C++
+// runtime's start-up and the C library (stdio's buffers, fopen()) all
+// allocate through malloc() and friends, so any heap use at all, by the
+// program or anything it calls, stops it where it happens.
+//
+// Include it in exactly one translation unit of the program, as
+// stoplights.cpp does in its -DPSM_EMBEDDED build.
+
+[[noreturn]] inline void psm_heap_used(const char *function, size_t length) {
+    static const char message[] = "heap used: ";
+    (void)!::write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void)!::write(STDERR_FILENO, function, length);
+    (void)!::write(STDERR_FILENO, "()\n", 3);
+    abort();
+}
+
+#define PSM_HEAP_USED(FUNCTION) psm_heap_used(FUNCTION, sizeof(FUNCTION) - 1)
+
+extern "C" void *malloc(size_t) noexcept {
+    PSM_HEAP_USED("malloc");
+}
+
+extern "C" void *calloc(size_t, size_t) noexcept {
+    PSM_HEAP_USED("calloc");
+}
+
+extern "C" void *realloc(void *, size_t) noexcept {
+    PSM_HEAP_USED("realloc");
+}
+
+extern "C" void *aligned_alloc(size_t, size_t) noexcept {
+    PSM_HEAP_USED("aligned_alloc");
+}
+
+extern "C" int posix_memalign(void **, size_t, size_t) noexcept {
+    PSM_HEAP_USED("posix_memalign");
+}
+
+extern "C" void free(void *p) noexcept {
+    if (p) {
+        PSM_HEAP_USED("free");
+    }
+}
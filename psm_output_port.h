@@ -0,0 +1,70 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <type_traits>
+
+// The image of a machine's on/off outputs, such as lamps or relays: a word the
+// machine sets by name while polling and writes out once at the end of each
+// poll(). The machine keeps it with
+//
+//    #define FOREACH_LAMP(X) X(red) X(yellow) X(green)
+//
+//    enum class lamp_t : uint8_t { FOREACH_LAMP(DECLARE_NAME) };
+//
+//    PSM_DECLARE_OUTPUTS(psm_output_image_t<lamp_t, uint8_t>)
+//
+// so psm_fleet_t keeps a word per member, and polls with
+//
+//    const auto written = psm_outputs;
+//    psm_outputs.set(lamp_t::red, true);                   // While polling
+//    psm_outputs.flush_since(written, write_outputs);      // On the way out
+//
+// set() only updates the image, with no branches and no lookups: the output's
+// enumerator is its bit position. flush_since() compares the image with what
+// it was when the poll began and calls   write   just once, and only if
+// something changed, so outputs set every poll to the value they already have
+// cost nothing downstream, and an output turned off and back on within one
+// poll is never toggled at all.
+template <typename output_t, typename word_t = unsigned>
+class psm_output_image_t {
+public:
+    static_assert(std::is_unsigned_v<word_t>, "word_t must be an unsigned integer type");
+
+    static constexpr size_t num_bits = sizeof(word_t) * CHAR_BIT;
+
+    void set(output_t output, bool on) {
+        const word_t mask = bit(output);
+        image = (image & ~mask) | (word_t(-word_t(on)) & mask);
+    }
+
+    [[nodiscard]] bool get(output_t output) const {
+        return image & bit(output);
+    }
+
+    // Calls   write(image, changed)   if any output changed since   written
+    // was, returning whether it did.
+    template <typename write_t>
+    bool flush_since(psm_output_image_t written, write_t&& write) const {
+        const word_t changed = image ^ written.image;
+        if (!changed) {
+            return false;
+        }
+        write(image, changed);
+        return true;
+    }
+
+    friend bool operator==(const psm_output_image_t&, const psm_output_image_t&) = default;
+
+private:
+
+    [[nodiscard]] static constexpr word_t bit(output_t output) {
+        return word_t(word_t(1) << (size_t)output);
+    }
+
+    word_t image = 0; // All outputs start off
+};
+
+#define PSM_DECLARE_OUTPUTS(image_t) \
+    image_t psm_outputs{};           \
+
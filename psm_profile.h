@@ -0,0 +1,269 @@
+#pragma once
+
+#include "polling_state_machine.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// A per-state profiler for PSM_DECLARE_PROFILER() (see "Profiling Hooks" in
+// polling_state_machine.h). For each state it counts entries,
+// exits, rejected transitions (an exit block ran but   next_state   was set
+// back to   state   ) and the cycles spent in that state's pass through the
+// actions, and records how long machines stayed in the state in a log-linear
+// histogram. It also tracks how many loop iterations each poll took (the longest
+// chain of transitions one poll ran) and how many polls ran out of transition
+// budget.
+//
+// It also counts transitions between each pair of states, and
+// export_dispatch_profile() writes the pass, entry, exit and transition counts
+// in a plain text form that dispatch_gen turns into dispatch hints (see
+// psm_dispatch.h).
+//
+// Time in state comes from the machine's   elapsed_ms()   at exit, if it has a
+// public one. Machines still in a state when the profile is written haven't
+// exited it, so pass each one's state and time so far to on_still_in_state()
+// first; export_to() reports those open intervals in columns of their own, so
+// a state machines never leave, like Faulted, still shows how long they've
+// been there.
+//
+// The counters are plain statics shared by every machine with this state enum,
+// so profile from one thread at a time.
+
+// Cycle counter: the TSC where there is one, nanoseconds elsewhere.
+inline uint64_t psm_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Log-linear histogram of 32-bit values: exact below 16, then 16 buckets per
+// power of two (about 6% resolution).
+class psm_log_linear_histogram_t {
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS     = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t NUM_BUCKETS     = SUB_BUCKETS + (32 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    void record(uint32_t value) {
+        ++counts[bucket_of(value)];
+        ++count;
+        if (value > max) {
+            max = value;
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] uint32_t maximum() const {
+        return max;
+    }
+
+    // An upper bound on the   p   th percentile: the highest value in its
+    // bucket, or the maximum recorded value if that's lower.
+    [[nodiscard]] uint32_t percentile(double p) const {
+        const size_t rank = (size_t)(p / 100 * count);
+        size_t seen = 0;
+        for (size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+            seen += counts[bucket];
+            if (seen > rank) {
+                return highest_value_in(bucket) < max ? highest_value_in(bucket) : max;
+            }
+        }
+        return max;
+    }
+
+private:
+
+    [[nodiscard]] static size_t bucket_of(uint32_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        const size_t exponent = 31 - __builtin_clz(value); // >= SUB_BUCKET_BITS
+        const size_t shift    = exponent - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    [[nodiscard]] static uint32_t highest_value_in(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return (uint32_t)bucket;
+        }
+        const size_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+        return (uint32_t)((((SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift) - 1));
+    }
+
+    size_t   counts[NUM_BUCKETS] = {};
+    size_t   count = 0;
+    uint32_t max   = 0;
+};
+
+template <typename state_t, size_t num_states>
+struct psm_state_profiler_t {
+    static constexpr bool   enabled                    = true;
+    static constexpr size_t MAX_ITERATIONS_HISTOGRAMMED = 16;
+
+    struct state_stats_t {
+        size_t                     entries  = 0;
+        size_t                     exits    = 0;
+        size_t                     rejected = 0;
+        size_t                     passes   = 0; // Loop iterations spent in this state
+        uint64_t                   cycles   = 0;
+        psm_log_linear_histogram_t time_in_state_ms;
+        psm_log_linear_histogram_t open_time_in_state_ms; // Machines yet to exit, from on_still_in_state()
+    };
+
+    static void on_poll_begin() {
+        iterations      = 0;
+        exit_block_ran  = false;
+        iteration_start = psm_cycles();
+    }
+
+    static void on_exit_block() {
+        exit_block_ran = true;
+    }
+
+    template <typename sm_t>
+    static void on_iteration(const sm_t& sm, state_t prev_state, state_t state, state_t next_state) {
+        const uint64_t now = psm_cycles();
+        state_stats_t& stats = states[(size_t)state];
+
+        ++iterations;
+        ++stats.passes;
+        stats.cycles += now - iteration_start;
+        iteration_start = now;
+
+        if (state != prev_state) {
+            ++stats.entries;
+            ++transitions[(size_t)prev_state][(size_t)state];
+        }
+        if (state != next_state) {
+            ++stats.exits;
+            if constexpr (requires { sm.elapsed_ms(); }) {
+                stats.time_in_state_ms.record((uint32_t)sm.elapsed_ms());
+            }
+        }
+        else if (exit_block_ran) {
+            ++stats.rejected;
+        }
+        exit_block_ran = false;
+    }
+
+    // Records that a machine is still in   state   , entered   elapsed_ms
+    // ago. Not a hook PSM_DO_ACTIONS() calls: call it for each machine before
+    // export_to(), once per export, as reset() clears them.
+    static void on_still_in_state(state_t state, uint32_t elapsed_ms) {
+        states[(size_t)state].open_time_in_state_ms.record(elapsed_ms);
+    }
+
+    static void on_budget_exhausted() {
+        ++budget_exhausted;
+    }
+
+    static void on_poll_end() {
+        ++polls;
+        ++iterations_per_poll[iterations < MAX_ITERATIONS_HISTOGRAMMED ? iterations : MAX_ITERATIONS_HISTOGRAMMED];
+        if (iterations > max_iterations_per_poll) {
+            max_iterations_per_poll = iterations;
+        }
+    }
+
+    static void reset() {
+        for (auto& stats : states) {
+            stats = state_stats_t{};
+        }
+        for (auto& count : iterations_per_poll) {
+            count = 0;
+        }
+        for (auto& from : transitions) {
+            for (auto& count : from) {
+                count = 0;
+            }
+        }
+        polls                   = 0;
+        max_iterations_per_poll = 0;
+        budget_exhausted        = 0;
+    }
+
+    // Writes a table of the counters, one row per state named from
+    // state_names   (as generated by DECLARE_STRING, starting with "unset").
+    static void export_to(std::ostream& out, const char *const state_names[]) {
+        out << std::left  << std::setw(16) << "state"
+            << std::right << std::setw(10) << "entries"
+                          << std::setw(10) << "exits"
+                          << std::setw(10) << "rejected"
+                          << std::setw(10) << "passes"
+                          << std::setw(14) << "cycles/pass"
+                          << std::setw(12) << "ms p50"
+                          << std::setw(12) << "ms p99"
+                          << std::setw(12) << "ms max"
+                          << std::setw(10) << "still in"
+                          << std::setw(12) << "open ms max"
+                          << "\n";
+        for (size_t i = 0; i < num_states; ++i) {
+            const state_stats_t& stats = states[i];
+            out << std::left  << std::setw(16) << state_names[i]
+                << std::right << std::setw(10) << stats.entries
+                              << std::setw(10) << stats.exits
+                              << std::setw(10) << stats.rejected
+                              << std::setw(10) << stats.passes
+                              << std::setw(14) << (stats.passes ? stats.cycles / stats.passes : 0)
+                              << std::setw(12) << stats.time_in_state_ms.percentile(50)
+                              << std::setw(12) << stats.time_in_state_ms.percentile(99)
+                              << std::setw(12) << stats.time_in_state_ms.maximum()
+                              << std::setw(10) << stats.open_time_in_state_ms.size()
+                              << std::setw(12) << stats.open_time_in_state_ms.maximum()
+                              << "\n";
+        }
+
+        out << polls << " polls, max " << max_iterations_per_poll << " iterations per poll, "
+            << budget_exhausted << " out of transition budget; iterations: polls";
+        for (size_t i = 0; i <= MAX_ITERATIONS_HISTOGRAMMED; ++i) {
+            if (iterations_per_poll[i]) {
+                out << "  " << i << (i == MAX_ITERATIONS_HISTOGRAMMED ? "+" : "") << ": " << iterations_per_poll[i];
+            }
+        }
+        out << "\n";
+    }
+
+    // Writes the counters dispatch_gen reads, one record per line:
+    //
+    //    polls <polls>
+    //    state <name> <passes> <entries> <exits>        (every state)
+    //    transition <from> <to> <count>                 (pairs with a count)
+    static void export_dispatch_profile(std::ostream& out, const char *const state_names[]) {
+        out << "polls " << polls << "\n";
+        for (size_t i = 0; i < num_states; ++i) {
+            out << "state " << state_names[i] << " " << states[i].passes << " " << states[i].entries << " " << states[i].exits << "\n";
+        }
+        for (size_t from = 0; from < num_states; ++from) {
+            for (size_t to = 0; to < num_states; ++to) {
+                if (transitions[from][to]) {
+                    out << "transition " << state_names[from] << " " << state_names[to] << " " << transitions[from][to] << "\n";
+                }
+            }
+        }
+    }
+
+    // Data members
+
+    static inline state_stats_t states[num_states];
+    static inline size_t        transitions[num_states][num_states]; // [from][to]
+    static inline size_t        iterations_per_poll[MAX_ITERATIONS_HISTOGRAMMED + 1];
+    static inline size_t        polls;
+    static inline size_t        max_iterations_per_poll;
+    static inline size_t        budget_exhausted; // Polls stopped by PSM_DECLARE_TRANSITION_BUDGET()
+
+    static inline size_t        iterations;
+    static inline bool          exit_block_ran;
+    static inline uint64_t      iteration_start;
+};
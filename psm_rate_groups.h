@@ -0,0 +1,96 @@
+#pragma once
+
+#include "psm_fleet.h"
+
+#include <cstddef>
+#include <vector>
+
+// Multi-rate polling: machines whose logic needs only 10 ms or 100 ms
+// resolution needn't be polled every ms. A machine class declares its period
+// with
+//
+//    PSM_DECLARE_POLL_PERIOD(100)
+//
+// and psm_rate_groups_t polls each fleet added to it at its class's period
+// (1 ms for classes that don't declare one). Rather than polling a whole
+// 100 ms fleet every 100th tick, it polls 1/100th of it every tick, so each
+// member is still polled exactly once per period but the load is spread
+// evenly over the ticks; groups of the same period carry on the slicing where
+// the previous one left off, so even small groups don't pile onto the same
+// tick.
+//
+// Coarser polling only delays when a machine notices something, by up to one
+// period: elapsed_ms() and psm_elapsed_ms32() read the clock rather than
+// counting polls, so time in state stays exact, and a deadline is acted on
+// at the first poll at or after it. Machines that must react to an input
+// within a ms should stay at 1 ms.
+#define PSM_DECLARE_POLL_PERIOD(period_ms)                                   \
+    static constexpr size_t psm_poll_period_ms = period_ms;                  \
+    static_assert(psm_poll_period_ms > 0, "poll period must be at least 1 ms"); \
+
+template <typename machine_t>
+constexpr size_t psm_poll_period_ms_of() {
+    if constexpr (requires { machine_t::psm_poll_period_ms; }) {
+        return machine_t::psm_poll_period_ms;
+    }
+    else {
+        return 1;
+    }
+}
+
+class psm_rate_groups_t {
+public:
+
+    // Adds   fleet   , polled at its machine class's period. The fleet must
+    // outlive this and keep its size.
+    template <typename machine_t>
+    void add(psm_fleet_t<machine_t>& fleet) {
+        add(fleet, psm_poll_period_ms_of<machine_t>());
+    }
+
+    template <typename machine_t>
+    void add(psm_fleet_t<machine_t>& fleet, size_t period_ms) {
+        size_t phase = 0; // Where the previous group of this period left off
+        for (const group_t& group : groups) {
+            if (group.period_ms == period_ms) {
+                phase = (phase + group.size) % period_ms;
+            }
+        }
+
+        groups.push_back({
+            &fleet,
+            [] (void *fleet, size_t begin, size_t end) { ((psm_fleet_t<machine_t> *)fleet)->poll(begin, end); },
+            fleet.size(),
+            period_ms,
+            phase,
+        });
+    }
+
+    // Call 1/ms with the tick number; polls this tick's slice of each group
+    // and returns how many members that was.
+    size_t poll(size_t tick) {
+        size_t num_polled = 0;
+        for (const group_t& group : groups) {
+            const size_t slice = (tick + group.phase) % group.period_ms;
+            const size_t begin = slice       * group.size / group.period_ms;
+            const size_t end   = (slice + 1) * group.size / group.period_ms;
+            if (begin != end) {
+                group.poll(group.fleet, begin, end);
+                num_polled += end - begin;
+            }
+        }
+        return num_polled;
+    }
+
+private:
+
+    struct group_t {
+        void   *fleet;
+        void  (*poll)(void *fleet, size_t begin, size_t end);
+        size_t  size;
+        size_t  period_ms;
+        size_t  phase;
+    };
+
+    std::vector<group_t> groups;
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "psm_fleet.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Checkpoint and restore of a psm_fleet_t, so a restarted process picks up
+// every member where it left off (including, say, a Faulted stoplight that
+// must stay Faulted until power cycled) instead of starting them all over
+// from unset.
+//
+// A snapshot is a header followed by the fleet's arrays, each starting on a
+// 64-byte boundary, with every timestamp stored relative to when the snapshot
+// was taken: how long each member has been in its state, and how far off its
+// next deadline is. psm_restore_snapshot() maps the file and copies the
+// arrays straight out of the mapping, re-basing the timestamps to the new
+// clock in the same pass, so a member that had been Red for 3 s when saved
+// has been Red for 3 s when restored. Members' output images (see
+// PSM_DECLARE_OUTPUTS()) are saved too, and since the outputs themselves
+// start off after a restart, restoring writes out every one that's on (see
+// psm_fleet_t::write_outputs()), so a stoplight restored mid-Red is lit
+// without waiting for its next transition. bench/snapshot_bench times a
+// million stoplights.
+//
+// Saving writes to   path.tmp   and renames it over   path   , so a crash
+// while saving leaves the previous snapshot intact. Both functions return
+// false with errno set on failure. Saving then syncs the directory, so the
+// rename itself survives a power cut. psm_restore_snapshot() sets EINVAL,
+// leaving the fleet as it was, for a file that isn't a snapshot of this kind
+// of fleet: one saved from another machine class or state list, going by
+// the header's type tag and number of states, or holding a state past the
+// last one.
+//
+// machine_t must use PSM_DECLARE_PACKED_STATE_MACHINE_FIELDS(), as
+// timestamps are saved modulo 2^32, and PSM_DECLARE_MACHINE_TYPE().
+
+struct psm_snapshot_header_t {
+    char     magic[8];                 // PSM_SNAPSHOT_MAGIC
+    uint64_t num_machines;
+    uint64_t type_tag;                 // machine_t::psm_type_tag
+    uint32_t num_states;               // machine_t::psm_num_states
+    uint8_t  state_size;               // sizeof(state_t)
+    uint8_t  has_carried_prev_state;   // See PSM_DECLARE_TRANSITION_BUDGET()
+    uint8_t  has_wake_ms;              // See psm_fleet_t's guard pre-pass
+    uint8_t  output_size;              // sizeof each output image (PSM_DECLARE_OUTPUTS()), 0 if none
+};
+
+static_assert(sizeof(psm_snapshot_header_t) == 32, "snapshot headers are written to files as-is");
+
+inline constexpr char PSM_SNAPSHOT_MAGIC[8] = { 'P', 'S', 'M', 'S', 'N', 'A', 'P', '3' };
+
+// Where each array lives in a snapshot of   num_machines   members.
+struct psm_snapshot_layout_t {
+    size_t state;
+    size_t next_state;
+    size_t state_age_ms;
+    size_t carried_prev_state;
+    size_t wake_in_ms;
+    size_t outputs;
+    size_t size;
+
+    psm_snapshot_layout_t(size_t num_machines, size_t state_size, bool has_carried_prev_state, bool has_wake_ms, size_t output_size) {
+        size_t offset = 0;
+        const auto place = [&] (size_t bytes) {
+            offset = (offset + 63) & ~size_t(63);
+            const size_t at = offset;
+            offset += bytes;
+            return at;
+        };
+        place(sizeof(psm_snapshot_header_t));
+        state              = place(num_machines * state_size);
+        next_state         = place(num_machines * state_size);
+        state_age_ms       = place(num_machines * sizeof(uint32_t));
+        carried_prev_state = place(has_carried_prev_state ? num_machines * state_size : 0);
+        wake_in_ms         = place(has_wake_ms            ? num_machines * sizeof(int32_t) : 0);
+        outputs            = place(num_machines * output_size);
+        size = offset;
+    }
+};
+
+// sizeof each of a fleet's output images, 0 if its members have none.
+template <typename fleet_t>
+[[nodiscard]] constexpr uint8_t psm_snapshot_output_size() {
+    if constexpr (fleet_t::has_outputs) {
+        static_assert(std::is_trivially_copyable_v<typename fleet_t::outputs_t>, "output images are written to files as-is");
+        return sizeof(typename fleet_t::outputs_t);
+    }
+    return 0;
+}
+
+template <typename machine_t>
+[[nodiscard]] bool psm_save_snapshot(const psm_fleet_t<machine_t>& fleet, const char *path, size_t now_ms) {
+    using fleet_t = psm_fleet_t<machine_t>;
+    using state_t = typename fleet_t::state_t;
+    static_assert(sizeof(typename fleet_t::ms_t) == sizeof(uint32_t), "snapshots need 32-bit state_entered_ms");
+
+    const size_t n = fleet.size();
+    const psm_snapshot_layout_t layout(n, sizeof(state_t), fleet_t::has_budget, fleet_t::has_guards, psm_snapshot_output_size<fleet_t>());
+
+    psm_snapshot_header_t header{};
+    memcpy(header.magic, PSM_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.num_machines           = n;
+    header.type_tag               = machine_t::psm_type_tag;
+    header.num_states             = machine_t::psm_num_states;
+    header.state_size             = sizeof(state_t);
+    header.has_carried_prev_state = fleet_t::has_budget;
+    header.has_wake_ms            = fleet_t::has_guards;
+    header.output_size            = psm_snapshot_output_size<fleet_t>();
+
+    const std::string tmp_path = std::string(path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    const auto write_at = [&] (size_t offset, const void *data, size_t bytes) {
+        fseek(file, (long)offset, SEEK_SET);
+        fwrite(data, 1, bytes, file);
+    };
+
+    // Relative timestamps go out a chunk at a time.
+    const auto write_relative = [&] (size_t offset, auto relative) {
+        uint32_t chunk[4096];
+        for (size_t begin = 0; begin < n; begin += std::size(chunk)) {
+            const size_t count = std::min(n - begin, std::size(chunk));
+            for (size_t i = 0; i < count; ++i) {
+                chunk[i] = relative(begin + i);
+            }
+            write_at(offset + begin * sizeof(uint32_t), chunk, count * sizeof(uint32_t));
+        }
+    };
+
+    const uint32_t now = (uint32_t)now_ms;
+
+    write_at(0,                 &header,                 sizeof(header));
+    write_at(layout.state,      fleet.state.data(),      n * sizeof(state_t));
+    write_at(layout.next_state, fleet.next_state.data(), n * sizeof(state_t));
+    write_relative(layout.state_age_ms, [&] (size_t i) { return now - fleet.state_entered_ms[i]; });
+    if constexpr (fleet_t::has_budget) {
+        write_at(layout.carried_prev_state, fleet.carried_prev_state.data(), n * sizeof(state_t));
+    }
+    if constexpr (fleet_t::has_guards) {
+        write_relative(layout.wake_in_ms, [&] (size_t i) { return fleet.wake_ms[i] - now; });
+    }
+    if constexpr (fleet_t::has_outputs) {
+        write_at(layout.outputs, fleet.outputs.data(), n * sizeof(typename fleet_t::outputs_t));
+    }
+    if (ftell(file) < (long)layout.size) { // Pad out the last array's alignment
+        write_at(layout.size - 1, "", 1);
+    }
+
+    const bool ok = !ferror(file) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !ok || rename(tmp_path.c_str(), path) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    // The rename is only durable once the directory holding   path   is.
+    const char        *slash    = strrchr(path, '/');
+    const std::string  dir_path = !slash ? "." : slash == path ? "/" : std::string(path, slash - path);
+    const int          dir      = ::open(dir_path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir < 0) {
+        return false;
+    }
+    const bool synced = fsync(dir) == 0;
+    ::close(dir);
+    if (!synced) {
+        return false;
+    }
+    return true;
+}
+
+template <typename machine_t>
+[[nodiscard]] bool psm_restore_snapshot(psm_fleet_t<machine_t>& fleet, const char *path, size_t now_ms) {
+    using fleet_t = psm_fleet_t<machine_t>;
+    using state_t = typename fleet_t::state_t;
+    using ms_t    = typename fleet_t::ms_t;
+    static_assert(sizeof(ms_t) == sizeof(uint32_t), "snapshots need 32-bit state_entered_ms");
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size < (off_t)sizeof(psm_snapshot_header_t)) {
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    const char *base = (const char *)p;
+
+    psm_snapshot_header_t header;
+    memcpy(&header, base, sizeof(header));
+    const size_t n = header.num_machines;
+
+    bool ok = memcmp(header.magic, PSM_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0
+        && header.type_tag               == machine_t::psm_type_tag
+        && header.num_states             == machine_t::psm_num_states
+        && header.state_size             == sizeof(state_t)
+        && header.has_carried_prev_state == fleet_t::has_budget
+        && header.has_wake_ms            == fleet_t::has_guards
+        && header.output_size            == psm_snapshot_output_size<fleet_t>()
+        && n <= (size_t)st.st_size // So the layout can't overflow
+        && psm_snapshot_layout_t(n, sizeof(state_t), fleet_t::has_budget, fleet_t::has_guards, header.output_size).size <= (size_t)st.st_size;
+
+    const psm_snapshot_layout_t layout(n, sizeof(state_t), fleet_t::has_budget, fleet_t::has_guards, header.output_size);
+
+    // Every state must be one of machine_t's, or its switch would find none.
+    const auto states_valid = [&] (size_t offset) {
+        const state_t *states = (const state_t *)(base + offset);
+        return std::all_of(states, states + n, [] (state_t s) { return (size_t)s < machine_t::psm_num_states; });
+    };
+    if (ok) {
+        ok = states_valid(layout.state)
+            && states_valid(layout.next_state)
+            && (!fleet_t::has_budget || states_valid(layout.carried_prev_state));
+    }
+    if (!ok) {
+        munmap(p, st.st_size);
+        errno = EINVAL;
+        return false;
+    }
+
+    fleet.resize(n);
+
+    const uint32_t  now     = (uint32_t)now_ms;
+    const uint32_t *age_ms  = (const uint32_t *)(base + layout.state_age_ms);
+    ms_t           *entered = fleet.state_entered_ms.data();
+
+    memcpy(fleet.state.data(),      base + layout.state,      n * sizeof(state_t));
+    memcpy(fleet.next_state.data(), base + layout.next_state, n * sizeof(state_t));
+    for (size_t i = 0; i < n; ++i) {
+        entered[i] = now - age_ms[i];
+    }
+    if constexpr (fleet_t::has_budget) {
+        memcpy(fleet.carried_prev_state.data(), base + layout.carried_prev_state, n * sizeof(state_t));
+    }
+    if constexpr (fleet_t::has_guards) {
+        const uint32_t *wake_in_ms = (const uint32_t *)(base + layout.wake_in_ms);
+        ms_t           *wake       = fleet.wake_ms.data();
+        for (size_t i = 0; i < n; ++i) {
+            wake[i] = now + wake_in_ms[i];
+        }
+    }
+    if constexpr (fleet_t::has_outputs) {
+        memcpy((void *)fleet.outputs.data(), base + layout.outputs, n * sizeof(typename fleet_t::outputs_t));
+    }
+
+    munmap(p, st.st_size);
+
+    if constexpr (fleet_t::has_outputs) {
+        fleet.write_outputs(); // They're all off after a restart
+    }
+    return true;
+}
@@ -0,0 +1,399 @@
+#pragma once
+
+#include "psm_fleet.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Live export of a psm_fleet_t's states to a POSIX shared memory segment, for
+// monitors that want to see every member's state without parsing logs or
+// stopping the fleet.
+//
+// The segment holds, for each member, its state index, the low 32 bits of its
+// state_entered_ms   and the number of publishes that found it had entered a
+// state since the last (changed state, or re-entered the same one). That's
+// not a count of transitions: publish() sees only where a member ended up, so
+// all the entries between two publishes, like a chain of transitions within
+// one poll, count as one. The members are
+// cut into fixed-size shards, each guarded by its own seqlock: publish()
+// makes the shard's sequence number odd, updates the members whose state or
+// entry time changed, then makes it even again. It never waits for anything,
+// so readers can't stall a polling thread.
+//
+// Readers (psm_state_export_reader_t, or `state_monitor`) map the segment
+// read-only and copy a shard out, retrying if its sequence number was odd or
+// moved while they copied. Reading takes no locks, just loads from the
+// mapping, and no syscalls unless a shard is mid-publish, when the reader
+// yields while it waits; a reader can't block a writer, and a copy is never
+// torn. A reader gives up on a shard after a bounded time, so a writer that
+// died mid-publish, leaving the sequence number odd for good, can't hang it.
+// It reports the shard busy if the sequence number has moved since it last
+// read the shard, as when the writer is only slow or was preempted, and stale
+// if it hasn't, as when the writer died.
+//
+// Publish each shard from the thread that just polled it, say from
+// psm_work_stealing_scheduler_t::on_shard_polled() with the same shard size.
+// There must be only one publish() of a shard at a time.
+
+struct psm_state_export_header_t {
+    char     magic[8];       // PSM_STATE_EXPORT_MAGIC
+    uint64_t num_machines;
+    uint64_t shard_size;
+    uint64_t num_shards;
+};
+
+static_assert(sizeof(psm_state_export_header_t) == 32, "export headers are shared between processes as-is");
+
+inline constexpr char PSM_STATE_EXPORT_MAGIC[8] = { 'P', 'S', 'M', 'E', 'X', 'P', 'O', '1' };
+
+// A shard's seqlock, alone on its cache line so writers of neighbouring
+// shards don't contend.
+struct alignas(64) psm_state_export_shard_t {
+    uint32_t sequence;       // Odd while publish() is updating the shard
+    uint32_t published_ms;   // now_ms   as of the last publish()
+};
+
+// One member as read from the segment.
+struct psm_exported_state_t {
+    uint32_t state;
+    uint32_t state_entered_ms;
+    uint32_t num_entries_seen; // Publishes that found a state entry; see above
+};
+
+// How long a reader waits for a shard that's mid-publish before giving up on
+// it, and how many tries it spins for, pausing between them, before it starts
+// yielding the CPU instead, in case the writer is waiting for it.
+inline constexpr std::chrono::microseconds PSM_STATE_EXPORT_MAX_WAIT{2000};
+inline constexpr size_t                    PSM_STATE_EXPORT_SPIN_TRIES = 64;
+
+// What psm_state_export_reader_t::read_shard() found.
+enum class psm_shard_read_t : uint8_t {
+    ok,    // Copied
+    busy,  // Mid-publish throughout, but published since the last read
+    stale, // Mid-publish throughout, with nothing published since the last read
+};
+
+// Where each part of a segment for   num_machines   members lives.
+struct psm_state_export_layout_t {
+    size_t shards;
+    size_t state;
+    size_t state_entered_ms;
+    size_t num_entries_seen;
+    size_t size;
+
+    psm_state_export_layout_t(size_t num_machines, size_t num_shards) {
+        size_t offset = 0;
+        const auto place = [&] (size_t bytes) {
+            offset = (offset + 63) & ~size_t(63);
+            const size_t at = offset;
+            offset += bytes;
+            return at;
+        };
+        place(sizeof(psm_state_export_header_t));
+        shards           = place(num_shards   * sizeof(psm_state_export_shard_t));
+        state            = place(num_machines * sizeof(uint32_t));
+        state_entered_ms = place(num_machines * sizeof(uint32_t));
+        num_entries_seen = place(num_machines * sizeof(uint32_t));
+        size = offset;
+    }
+};
+
+// Every access to shared words goes through this, so neither side's compiler
+// may cache, split or reorder them beyond what the seqlock's fences allow.
+// (Read-only mappings are only ever loaded from.)
+inline std::atomic_ref<uint32_t> psm_shared_word(const uint32_t& word) {
+    return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(word));
+}
+
+template <typename machine_t>
+class psm_state_exporter_t {
+public:
+    using fleet_t = psm_fleet_t<machine_t>;
+
+    psm_state_exporter_t() = default;
+
+    psm_state_exporter_t(const psm_state_exporter_t&) = delete;
+    psm_state_exporter_t& operator=(const psm_state_exporter_t&) = delete;
+
+    // Unlinks the segment; readers that have it mapped keep their mapping.
+    ~psm_state_exporter_t() {
+        if (base) {
+            munmap(base, layout.size);
+            shm_unlink(name);
+        }
+    }
+
+    // Creates (or replaces) the segment   name   , e.g. "/stoplights", for
+    // num_machines   members in shards of   shard_size   , all unset. Returns
+    // false with errno set on failure.
+    [[nodiscard]] bool open(const char *name_, size_t num_machines, size_t shard_size_) {
+        if (base || shard_size_ == 0 || strlen(name_) >= sizeof(name)) {
+            errno = EINVAL;
+            return false;
+        }
+        shard_size = shard_size_;
+        num_shards = (num_machines + shard_size - 1) / shard_size;
+        layout     = psm_state_export_layout_t(num_machines, num_shards);
+
+        const int fd = shm_open(name_, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        // Truncating to 0 first zeroes any segment left behind by a previous run.
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)layout.size) != 0) {
+            ::close(fd);
+            shm_unlink(name_);
+            return false;
+        }
+        void *p = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(name_);
+            return false;
+        }
+        base = (char *)p;
+        strcpy(name, name_);
+
+        psm_state_export_header_t& header = *(psm_state_export_header_t *)base;
+        header.num_machines = num_machines;
+        header.shard_size   = shard_size;
+        header.num_shards   = num_shards;
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(header.magic, PSM_STATE_EXPORT_MAGIC, sizeof(header.magic)); // Last, so readers see a complete header
+        return true;
+    }
+
+    // Publishes the members of   shard   ,   [shard * shard_size, ...)   .
+    void publish(const fleet_t& fleet, size_t shard, size_t now_ms) {
+        const size_t begin = shard * shard_size;
+        const size_t end   = std::min(begin + shard_size, fleet.size());
+
+        psm_state_export_shard_t& lock = shards()[shard];
+        auto sequence = psm_shared_word(lock.sequence);
+        const uint32_t s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // Odd before any data changes
+
+        uint32_t *state       = words(layout.state);
+        uint32_t *entered_ms  = words(layout.state_entered_ms);
+        uint32_t *num_entries = words(layout.num_entries_seen);
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t new_state      = (uint32_t)fleet.state[i];
+            const uint32_t new_entered_ms = (uint32_t)fleet.state_entered_ms[i];
+            // Only this thread writes these, so reading them back needs no ordering.
+            if (new_state != psm_shared_word(state[i]).load(std::memory_order_relaxed)
+                || new_entered_ms != psm_shared_word(entered_ms[i]).load(std::memory_order_relaxed)) {
+                psm_shared_word(state[i])      .store(new_state,      std::memory_order_relaxed);
+                psm_shared_word(entered_ms[i]) .store(new_entered_ms, std::memory_order_relaxed);
+                psm_shared_word(num_entries[i]).store(psm_shared_word(num_entries[i]).load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+        psm_shared_word(lock.published_ms).store((uint32_t)now_ms, std::memory_order_relaxed);
+
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    // Publishes every shard, for single-threaded callers.
+    void publish(const fleet_t& fleet, size_t now_ms) {
+        for (size_t shard = 0; shard < num_shards; ++shard) {
+            publish(fleet, shard, now_ms);
+        }
+    }
+
+private:
+
+    psm_state_export_shard_t *shards() {
+        return (psm_state_export_shard_t *)(base + layout.shards);
+    }
+
+    uint32_t *words(size_t offset) {
+        return (uint32_t *)(base + offset);
+    }
+
+    // Data members
+
+    char                      *base       = nullptr;
+    psm_state_export_layout_t  layout{0, 0};
+    size_t                     shard_size = 0;
+    size_t                     num_shards = 0;
+    char                       name[256]  = "";
+};
+
+class psm_state_export_reader_t {
+public:
+    psm_state_export_reader_t() = default;
+
+    psm_state_export_reader_t(const psm_state_export_reader_t&) = delete;
+    psm_state_export_reader_t& operator=(const psm_state_export_reader_t&) = delete;
+
+    ~psm_state_export_reader_t() {
+        if (base) {
+            munmap((void *)base, mapped_size);
+        }
+    }
+
+    // Maps the segment   name   read-only. Returns false with errno set on
+    // failure, EINVAL if it isn't a complete export segment.
+    [[nodiscard]] bool open(const char *name) {
+        const int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size < (off_t)sizeof(psm_state_export_header_t)) {
+            ::close(fd);
+            errno = EINVAL;
+            return false;
+        }
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+
+        psm_state_export_header_t header;
+        memcpy(header.magic, p, sizeof(header.magic));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        memcpy(&header, p, sizeof(header));
+
+        const bool ok = memcmp(header.magic, PSM_STATE_EXPORT_MAGIC, sizeof(header.magic)) == 0
+            && header.shard_size > 0
+            && header.num_machines <= (uint64_t)st.st_size // So the layout can't overflow
+            && header.num_shards == (header.num_machines + header.shard_size - 1) / header.shard_size
+            && psm_state_export_layout_t(header.num_machines, header.num_shards).size <= (size_t)st.st_size;
+        if (!ok) {
+            munmap(p, st.st_size);
+            errno = EINVAL;
+            return false;
+        }
+
+        base        = (const char *)p;
+        mapped_size = st.st_size;
+        geometry    = header;
+        layout      = psm_state_export_layout_t(header.num_machines, header.num_shards);
+        last_sequence.resize(header.num_shards);
+        for (size_t shard = 0; shard < header.num_shards; ++shard) {
+            last_sequence[shard] = psm_shared_word(shards()[shard].sequence).load(std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return geometry.num_machines;
+    }
+
+    [[nodiscard]] size_t shard_size() const {
+        return geometry.shard_size;
+    }
+
+    [[nodiscard]] size_t num_shards() const {
+        return geometry.num_shards;
+    }
+
+    // Copies a consistent view of   shard   's members to   out   (room for
+    // shard_size()   of them) and sets   published_ms   to when it was
+    // published. Waits while a publish() of the shard is under way, spinning
+    // at first, then yielding; the view is of the shard as one publish() left
+    // it. Gives up if there was no consistent view to copy within   max_wait
+    // , leaving   out   holding none, and returns busy if the shard's
+    // sequence number moved since this reader last read the shard (or opened
+    // the segment), stale if it didn't. One thread at a time per reader.
+    [[nodiscard]] psm_shard_read_t read_shard(size_t shard, psm_exported_state_t *out, uint32_t& published_ms,
+                                              size_t *num_retries = nullptr,
+                                              std::chrono::microseconds max_wait = PSM_STATE_EXPORT_MAX_WAIT) {
+        const psm_state_export_shard_t& lock = shards()[shard];
+        const size_t begin = shard * geometry.shard_size;
+        const size_t end   = std::min<size_t>(begin + geometry.shard_size, geometry.num_machines);
+
+        const uint32_t *state       = words(layout.state);
+        const uint32_t *entered_ms  = words(layout.state_entered_ms);
+        const uint32_t *num_entries = words(layout.num_entries_seen);
+
+        const auto give_up = std::chrono::steady_clock::now() + max_wait;
+        uint32_t   s       = 0;
+        for (size_t tries = 0; ; ++tries) {
+            if (tries > 0) {
+                if (num_retries) {
+                    ++*num_retries;
+                }
+                if (tries < PSM_STATE_EXPORT_SPIN_TRIES) {
+                    pause();
+                }
+                else if (std::chrono::steady_clock::now() < give_up) {
+                    std::this_thread::yield(); // The writer may be waiting for this CPU
+                }
+                else {
+                    break;
+                }
+            }
+
+            s = psm_shared_word(lock.sequence).load(std::memory_order_acquire);
+            if (s & 1) {
+                continue;
+            }
+
+            for (size_t i = begin; i < end; ++i) {
+                out[i - begin] = {
+                    psm_shared_word(state[i])      .load(std::memory_order_relaxed),
+                    psm_shared_word(entered_ms[i]) .load(std::memory_order_relaxed),
+                    psm_shared_word(num_entries[i]).load(std::memory_order_relaxed),
+                };
+            }
+            const uint32_t copied_published_ms = psm_shared_word(lock.published_ms).load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire); // The copy before the recheck
+            if (psm_shared_word(lock.sequence).load(std::memory_order_relaxed) == s) {
+                published_ms         = copied_published_ms;
+                last_sequence[shard] = s;
+                return psm_shard_read_t::ok;
+            }
+        }
+
+        const bool moved = s != last_sequence[shard];
+        last_sequence[shard] = s;
+        return moved ? psm_shard_read_t::busy : psm_shard_read_t::stale;
+    }
+
+private:
+
+    [[nodiscard]] const psm_state_export_shard_t *shards() const {
+        return (const psm_state_export_shard_t *)(base + layout.shards);
+    }
+
+    [[nodiscard]] const uint32_t *words(size_t offset) const {
+        return (const uint32_t *)(base + offset);
+    }
+
+    static void pause() {
+#if defined(__SSE2__)
+        _mm_pause(); // Spare the writer's sibling hyperthread
+#endif
+    }
+
+    // Data members
+
+    const char                *base        = nullptr;
+    size_t                     mapped_size = 0;
+    psm_state_export_header_t  geometry{};
+    psm_state_export_layout_t  layout{0, 0};
+    std::vector<uint32_t>      last_sequence; // Each shard's sequence number as of the last read_shard()
+};
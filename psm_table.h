@@ -0,0 +1,109 @@
+#pragma once
+
+#include "X_macro_helpers.h"
+#include "polling_state_machine.h"
+
+#include <array>
+#include <cstddef>
+
+// Table Dispatch
+// ==============
+//
+// An alternative to writing a state dispatcher   switch   inside
+// PSM_DO_ACTIONS(): each state's actions live in a nested struct named after
+// the state, with optional static   entry()   ,   do_actions()   and   exit()
+// functions taking the machine, and PSM_DECLARE_HANDLER_TABLE() builds a
+// constexpr table of them, indexed by state, from the same X macro that
+// declares the states:
+//
+//    #define FOREACH_TRAFFIC_LIGHT_STATE(X) \.
+//        X(red)                             \.
+//        X(green)                           \.
+//
+//    struct traffic_light_t {
+//        enum class state_t { unset, FOREACH_TRAFFIC_LIGHT_STATE(DECLARE_NAME) };
+//
+//        struct unset {
+//            static void do_actions(traffic_light_t& sm) { sm.next_state = state_t::red; }
+//        };
+//        struct red {
+//            static void entry     (traffic_light_t& sm) { turn_on(&red_light); }
+//            static void do_actions(traffic_light_t& sm) { if (...) sm.next_state = state_t::green; }
+//            static void exit      (traffic_light_t& sm) { turn_off(&red_light); }
+//        };
+//        struct green { ... };
+//
+//        PSM_DECLARE_HANDLER_TABLE(traffic_light_t, FOREACH_TRAFFIC_LIGHT_STATE)
+//
+//        void poll() { psm_do_table_actions(*this, handler_table); }
+//
+//        PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
+//    };
+//
+// Entry, do and exit run under exactly the rules described for IF_ENTRY,
+// IF_DO and IF_EXIT in polling_state_machine.h, including an exit action
+// setting   next_state   back to   state   to cancel a transition, and call the
+// same profiling hooks, so a PSM_DECLARE_PROFILER() profiles a table-driven
+// machine as it would one written with PSM_DO_ACTIONS().
+//
+// The dispatch is one indexed load per pass instead of a   switch   followed
+// by a phase test per action block, with no call at all for phases a state
+// has no action for. That isn't faster, though: `bench/table_bench` measured
+// the table slower than the switch, whose jump table GCC builds and whose
+// action blocks it inlines, where each table entry costs an indirect call.
+
+// The compiler checks the table: a state in the X macro without a struct, or a
+// table whose size doesn't match the state enum, fails to compile.
+
+template <typename sm_t>
+struct psm_handlers_t {
+    void (*entry     )(sm_t&);
+    void (*do_actions)(sm_t&);
+    void (*exit      )(sm_t&);
+};
+
+template <typename sm_t, typename state_actions_t>
+constexpr psm_handlers_t<sm_t> psm_handlers_for() {
+    psm_handlers_t<sm_t> handlers{};
+    if constexpr (requires (sm_t& sm) { state_actions_t::entry(sm);      }) { handlers.entry      = &state_actions_t::entry;      }
+    if constexpr (requires (sm_t& sm) { state_actions_t::do_actions(sm); }) { handlers.do_actions = &state_actions_t::do_actions; }
+    if constexpr (requires (sm_t& sm) { state_actions_t::exit(sm);       }) { handlers.exit       = &state_actions_t::exit;       }
+    return handlers;
+}
+
+template <typename sm_t, size_t num_states>
+using psm_handler_table_t = std::array<psm_handlers_t<sm_t>, num_states>;
+
+#define PSM_DECLARE_HANDLERS_(STATE, ...) psm_handlers_for<psm_sm_t, STATE>(),
+
+// Place in the machine's class after the per-state structs (including
+// unset   ). Declares   handler_table   .
+#define PSM_DECLARE_HANDLER_TABLE(sm_t, FOREACH_STATE)                                                \
+    using psm_sm_t = sm_t;                                                                            \
+    static constexpr psm_handler_table_t<sm_t, M_NUM_DECLS_IN(FOREACH_STATE) + 1> handler_table = {{  \
+        psm_handlers_for<sm_t, unset>(),                                                              \
+        FOREACH_STATE(PSM_DECLARE_HANDLERS_)                                                          \
+    }};                                                                                               \
+    static_assert((size_t)state_t::M_LAST_DECL_IN(FOREACH_STATE) + 1 == handler_table.size(),         \
+                  "handler_table must have one entry per state, plus unset");                         \
+
+// The table-driven equivalent of wrapping a dispatcher in PSM_DO_ACTIONS().
+template <typename sm_t, size_t num_states>
+inline void psm_do_table_actions(sm_t& sm, const psm_handler_table_t<sm_t, num_states>& table) {
+    auto prev_state = psm_profile_poll_begin(&sm.state);
+    while (true) {
+        const psm_handlers_t<sm_t>& handlers = table[(size_t)sm.state];
+
+        if (sm.state != prev_state      && handlers.entry                                          ) { handlers.entry(sm);      }
+        if (sm.state == sm.next_state   && handlers.do_actions                                     ) { handlers.do_actions(sm); }
+        if (sm.state != sm.next_state   && handlers.exit && psm_profile_exit_block(&sm.state)      ) { handlers.exit(sm);       }
+        psm_profile_iteration(sm, prev_state, sm.state, sm.next_state);
+
+        prev_state = sm.state;
+        sm.state   = sm.next_state;
+        if (prev_state == sm.next_state) {
+            psm_profile_poll_end(prev_state);
+            break; // No change
+        }
+    }
+}
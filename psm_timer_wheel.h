@@ -0,0 +1,243 @@
+#pragma once
+
+#include "psm_inputs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A hierarchical timing wheel holding one pending deadline per timer id, for
+// putting state machines to sleep until the time their current state next
+// needs to look at the clock.
+//
+// Four levels of 256 slots cover deadlines up to 2^32 ms (~49 days) ahead;
+// later deadlines wait on an overflow list. A timer lands in the level whose
+// byte of its deadline first differs from the current time's, and is cascaded
+// down a level each time the current time reaches its slot, so schedule(),
+// cancel() and each millisecond of advance() are O(1) regardless of how many
+// timers are pending.
+//
+// Timers are kept in intrusive doubly linked lists indexed by id, so the wheel
+// allocates only in its constructor.
+template <typename ms_t>
+class psm_timer_wheel_t {
+public:
+    psm_timer_wheel_t(size_t num_timers, ms_t now)
+        : deadline(num_timers)
+        , next(num_timers, NIL)
+        , prev(num_timers, NIL)
+        , list_of(num_timers, NIL)
+        , current(now)
+    {
+        for (auto& head : heads) {
+            head = NIL;
+        }
+    }
+
+    // Fires timer   id   at the first advance() reaching   when   (or at the
+    // next advance() if   when   has already passed), replacing any deadline
+    // already pending for it.
+    void schedule(size_t id, ms_t when) {
+        cancel(id);
+        deadline[id] = when > current ? when : current;
+        insert(id);
+        ++num_pending;
+    }
+
+    void cancel(size_t id) {
+        if (list_of[id] != NIL) {
+            unlink(id);
+            --num_pending;
+        }
+    }
+
+    [[nodiscard]] bool is_pending(size_t id) const {
+        return list_of[id] != NIL;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return num_pending;
+    }
+
+    // Calls   on_expired(id)   for each timer whose deadline is at or before
+    // now   , in deadline order. on_expired() may schedule() or cancel() any
+    // timer, including the expiring one.
+    template <typename F>
+    void advance(ms_t now, F&& on_expired) {
+        while (current <= now) {
+            if (num_pending == 0) {
+                current = now + 1; // Nothing to cascade or expire, jump ahead
+                return;
+            }
+
+            const ms_t t = current;
+
+            if (((uint64_t)t & 0xFFFFFFFFu) == 0) {
+                cascade(OVERFLOW_LIST);
+            }
+            for (size_t level = NUM_LEVELS - 1; level > 0; --level) {
+                if (((uint64_t)t & ((UINT64_C(1) << (BITS_PER_LEVEL * level)) - 1)) == 0) {
+                    cascade(list_index(level, t));
+                }
+            }
+
+            current = t + 1; // Timers scheduled by on_expired() go in later slots
+
+            const size_t expiring = list_index(0, t);
+            while (heads[expiring] != NIL) {
+                const size_t id = heads[expiring];
+                unlink(id);
+                --num_pending;
+                on_expired(id);
+            }
+        }
+    }
+
+private:
+
+    static constexpr size_t NIL            = SIZE_MAX;
+    static constexpr size_t NUM_LEVELS     = 4;
+    static constexpr size_t BITS_PER_LEVEL = 8;
+    static constexpr size_t SLOTS_PER_LEVEL = size_t(1) << BITS_PER_LEVEL;
+    static constexpr size_t OVERFLOW_LIST  = NUM_LEVELS * SLOTS_PER_LEVEL;
+
+    [[nodiscard]] static size_t list_index(size_t level, ms_t when) {
+        return level * SLOTS_PER_LEVEL + (((uint64_t)when >> (BITS_PER_LEVEL * level)) & (SLOTS_PER_LEVEL - 1));
+    }
+
+    void insert(size_t id) {
+        const uint64_t differing_bits = (uint64_t)deadline[id] ^ (uint64_t)current;
+
+        size_t list = OVERFLOW_LIST;
+        for (size_t level = 0; level < NUM_LEVELS; ++level) {
+            if ((differing_bits >> (BITS_PER_LEVEL * (level + 1))) == 0) {
+                list = list_index(level, deadline[id]);
+                break;
+            }
+        }
+
+        list_of[id] = list;
+        prev[id]    = NIL;
+        next[id]    = heads[list];
+        if (next[id] != NIL) {
+            prev[next[id]] = id;
+        }
+        heads[list] = id;
+    }
+
+    void unlink(size_t id) {
+        if (prev[id] != NIL) { next[prev[id]] = next[id]; } else { heads[list_of[id]] = next[id]; }
+        if (next[id] != NIL) { prev[next[id]] = prev[id]; }
+        list_of[id] = NIL;
+    }
+
+    void cascade(size_t list) {
+        while (heads[list] != NIL) {
+            const size_t id = heads[list];
+            unlink(id);
+            insert(id);
+        }
+    }
+
+    // Data members
+
+    std::vector<ms_t>   deadline;
+    std::vector<size_t> next;
+    std::vector<size_t> prev;
+    std::vector<size_t> list_of; // Which of heads[] each timer is on, NIL if not pending
+
+    size_t heads[NUM_LEVELS * SLOTS_PER_LEVEL + 1];
+    size_t num_pending = 0;
+    ms_t   current;              // Earliest time not yet advanced through
+};
+
+// Polls only the members of a psm_fleet_t whose deadline has arrived or that
+// have been woken by an event or input change, instead of every member on
+// every tick.
+//
+// machine_t::poll() must return the time it next needs to be polled if nothing
+// else happens; returning an earlier time than necessary only costs a spurious
+// poll. Each poll() still runs the machine's whole PSM_DO_ACTIONS loop, so a
+// machine sees exactly the entry/do/exit sequence it would see if polled every
+// tick; only polls that would have done nothing are skipped. Machines due on
+// the same tick are polled in deadline order, not index order.
+//
+// Members subscribe() to the psm_input_t sources their states read; each
+// poll() compares every source's epoch with the one it last saw and wakes
+// just that source's subscribers when it has moved on, so an input that only
+// a few members read never costs a pass over the whole fleet. Inputs set
+// between polls are seen at the next one; members read the value as of then.
+template <typename fleet_t>
+class psm_deadline_scheduler_t {
+public:
+    using ms_t = decltype(std::declval<fleet_t&>().poll(size_t{})); // What machine_t::poll() returns
+
+    psm_deadline_scheduler_t(fleet_t& fleet_, ms_t now)
+        : fleet(fleet_)
+        , wheel(fleet_.size(), now)
+    {
+        wake_all(now);
+    }
+
+    // Call after delivering an event to member   i   .
+    void wake(size_t i, ms_t now) {
+        wheel.schedule(i, now);
+    }
+
+    // Call after an input that any member may read, and that isn't a
+    // subscribed psm_input_t, changes.
+    void wake_all(ms_t now) {
+        for (size_t i = 0; i < fleet.size(); ++i) {
+            wheel.schedule(i, now);
+        }
+    }
+
+    // Wakes members   [begin, end)   whenever   input   changes.
+    void subscribe(const psm_input_source_t& input, size_t begin, size_t end) {
+        subscription_t *subscription = nullptr;
+        for (auto& s : subscriptions) {
+            if (s.input == &input) {
+                subscription = &s;
+            }
+        }
+        if (!subscription) {
+            subscription = &subscriptions.emplace_back(subscription_t{ &input, input.epoch(), {} });
+        }
+        for (size_t i = begin; i < end; ++i) {
+            subscription->subscribers.push_back((uint32_t)i);
+        }
+    }
+
+    void subscribe(const psm_input_source_t& input, size_t i) {
+        subscribe(input, i, i + 1);
+    }
+
+    void poll(ms_t now) { // Call 1/ms
+        for (auto& subscription : subscriptions) {
+            const uint32_t epoch = subscription.input->epoch();
+            if (epoch != subscription.seen_epoch) {
+                subscription.seen_epoch = epoch;
+                for (const uint32_t i : subscription.subscribers) {
+                    wheel.schedule(i, now);
+                }
+            }
+        }
+
+        wheel.advance(now, [&] (size_t i) {
+            wheel.schedule(i, fleet.poll(i));
+        });
+    }
+
+private:
+
+    struct subscription_t {
+        const psm_input_source_t *input;
+        uint32_t                  seen_epoch;
+        std::vector<uint32_t>     subscribers;
+    };
+
+    fleet_t&                    fleet;
+    psm_timer_wheel_t<ms_t>     wheel;
+    std::vector<subscription_t> subscriptions;
+};
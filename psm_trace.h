@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Binary tracing for polling state machines: instead of formatting log text
+// from inside poll(), machines append fixed-size records to a lock-free ring,
+// and something off the hot path (a main loop between ticks, a logging thread,
+// or an offline decoder reading a dump of the records) turns them into text.
+
+// Record kinds common to all machines. Applications number their own kinds
+// from PSM_TRACE_FIRST_USER_KIND.
+enum psm_trace_kind_t : uint8_t {
+    PSM_TRACE_ENTERED,   // to: state entered, from: state exited
+    PSM_TRACE_REQUESTED, // to: requested next_state, from: state
+    PSM_TRACE_REJECTED,  // to: rejected next_state, from: state kept
+    PSM_TRACE_FIRST_USER_KIND,
+};
+
+struct psm_trace_record_t {
+    uint64_t ms   : 48;
+    uint64_t kind : 8;
+    uint64_t arg  : 8;  // Kind-specific, e.g. on/off
+    uint32_t machine;   // Index of the machine within its fleet, 0 if alone
+    uint16_t from;      // State (or other table) indices
+    uint16_t to;
+};
+
+static_assert(sizeof(psm_trace_record_t) == 16, "trace records are written to files as-is");
+
+// The machine whose poll() is running on this thread, for tagging records.
+// Fleets set it before polling or visiting each member.
+inline thread_local uint32_t psm_trace_machine = 0;
+
+// A bounded multi-producer, multi-consumer ring of trace records (Vyukov's
+// bounded queue). Neither side ever blocks or takes a lock: try_push() on a
+// full ring drops the record and counts it, so a slow reader can never stall
+// a polling thread.
+template <size_t capacity>
+class psm_trace_ring_t {
+public:
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    psm_trace_ring_t() {
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(const psm_trace_record_t& record) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            cell_t& cell = cells[pos & (capacity - 1)];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.record = record;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false; // Full
+            }
+            else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(psm_trace_record_t& record) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            cell_t& cell = cells[pos & (capacity - 1)];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    record = cell.record;
+                    cell.sequence.store(pos + capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false; // Empty
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] size_t num_dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    struct cell_t {
+        std::atomic<size_t> sequence;
+        psm_trace_record_t  record;
+    };
+
+    cell_t cells[capacity];
+
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> dropped{0};
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// A bounded Chase-Lev work-stealing deque of shard indices. Its owner pops
+// from the bottom; any other thread steals from the top.
+//
+// Shards are only pushed while no thread is popping or stealing (between
+// ticks), so the deque never grows and push() needs no synchronization beyond
+// the release that starts the next tick.
+class psm_work_stealing_deque_t {
+public:
+    static constexpr size_t EMPTY = SIZE_MAX;
+    static constexpr size_t LOST  = SIZE_MAX - 1; // Raced with another thief; retry
+
+    explicit psm_work_stealing_deque_t(size_t capacity)
+        : shards(capacity)
+    {}
+
+    void clear() {
+        top.store(0, std::memory_order_relaxed);
+        bottom.store(0, std::memory_order_relaxed);
+    }
+
+    // Makes room for   capacity   shards, emptying the deque. Only between
+    // ticks, like push().
+    void resize(size_t capacity) {
+        shards.resize(capacity);
+        clear();
+    }
+
+    void push(size_t shard) {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        shards[b] = shard;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t pop() { // Owner only
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return EMPTY;
+        }
+
+        size_t shard = shards[b];
+        if (t == b) { // Last one; race thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                shard = EMPTY;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return shard;
+    }
+
+    [[nodiscard]] size_t steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return EMPTY;
+        }
+
+        const size_t shard = shards[t];
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return LOST;
+        }
+        return shard;
+    }
+
+private:
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::vector<size_t> shards;
+};
+
+// Polls a psm_fleet_t from several threads. Each tick the fleet is cut into
+// fixed-size shards dealt out in contiguous runs to per-thread deques; a
+// thread that runs out of its own shards steals from the others, so a run of
+// shards made slow by a burst of transitions (say, a mass error event) gets
+// spread across idle threads.
+//
+// Every shard is taken exactly once per tick, so every member is polled
+// exactly once per tick, and members are never polled concurrently with
+// events being delivered to them between ticks. The calling thread works as
+// thread 0; poll() returns once the whole tick is done. Members may be added
+// or removed between ticks too: each poll() cuts the fleet as it is then.
+//
+// machine_t::poll() must be safe to call from several threads at once for
+// different members (the stoplight mocks are when   log_enabled   is false).
+template <typename fleet_t>
+class psm_work_stealing_scheduler_t {
+public:
+    psm_work_stealing_scheduler_t(fleet_t& fleet_, size_t num_threads, size_t shard_size = 4096)
+        : fleet(fleet_)
+        , shard_size(shard_size)
+    {
+        num_threads = std::max<size_t>(num_threads, 1);
+        for (size_t i = 0; i < num_threads; ++i) {
+            deques.push_back(std::make_unique<psm_work_stealing_deque_t>(0));
+        }
+        fit_fleet();
+        for (size_t i = 1; i < num_threads; ++i) {
+            threads.emplace_back([this, i] { run_worker(i); });
+        }
+    }
+
+    ~psm_work_stealing_scheduler_t() {
+        stopping.store(true, std::memory_order_relaxed);
+        epoch.fetch_add(1, std::memory_order_release);
+        epoch.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    psm_work_stealing_scheduler_t(const psm_work_stealing_scheduler_t&) = delete;
+    psm_work_stealing_scheduler_t& operator=(const psm_work_stealing_scheduler_t&) = delete;
+
+    [[nodiscard]] size_t num_threads() const {
+        return deques.size();
+    }
+
+    // Calls   f(shard, begin, end)   from whichever thread polled a shard,
+    // right after polling it, e.g. to publish the shard's states with
+    // psm_state_exporter_t. Set it between ticks.
+    void on_shard_polled(std::function<void(size_t shard, size_t begin, size_t end)> f) {
+        shard_polled = std::move(f);
+    }
+
+    void poll() { // Call 1/ms
+        const size_t n = num_threads();
+
+        if (fleet.size() != num_machines) {
+            fit_fleet();
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            auto& deque = *deques[i];
+            deque.clear();
+            // Contiguous runs keep each thread's shards adjacent in memory.
+            // Pushed in reverse so the owner pops them in address order.
+            const size_t first = num_shards *  i      / n;
+            const size_t last  = num_shards * (i + 1) / n;
+            for (size_t shard = last; shard > first; --shard) {
+                deque.push(shard - 1);
+            }
+        }
+
+        num_busy_workers.store(n - 1, std::memory_order_relaxed);
+        epoch.fetch_add(1, std::memory_order_release);
+        epoch.notify_all();
+
+        run_tick(0);
+
+        // Wait for the workers to leave the deques alone before they're
+        // refilled next tick.
+        for (size_t spins = 0; ; ++spins) {
+            const size_t busy = num_busy_workers.load(std::memory_order_acquire);
+            if (busy == 0) {
+                break;
+            }
+            if (spins > SPINS_BEFORE_WAITING) {
+                num_busy_workers.wait(busy, std::memory_order_acquire);
+            }
+        }
+    }
+
+private:
+
+    static constexpr size_t SPINS_BEFORE_WAITING = 1 << 12;
+
+    // Cuts the fleet as it is now into shards, making room for them all in
+    // every deque, as stealing can move any shard to any thread. Only between
+    // ticks.
+    void fit_fleet() {
+        num_machines = fleet.size();
+        num_shards   = (num_machines + shard_size - 1) / shard_size;
+        for (auto& deque : deques) {
+            deque->resize(num_shards);
+        }
+    }
+
+    void run_worker(size_t self) {
+        uint64_t seen_epoch = 0;
+        while (true) {
+            for (size_t spins = 0; epoch.load(std::memory_order_acquire) == seen_epoch; ++spins) {
+                if (spins > SPINS_BEFORE_WAITING) {
+                    epoch.wait(seen_epoch, std::memory_order_acquire);
+                }
+            }
+            ++seen_epoch;
+
+            if (stopping.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            run_tick(self);
+
+            if (num_busy_workers.fetch_sub(1, std::memory_order_release) == 1) {
+                num_busy_workers.notify_all();
+            }
+        }
+    }
+
+    void run_tick(size_t self) {
+        for (size_t shard; (shard = deques[self]->pop()) != psm_work_stealing_deque_t::EMPTY; ) {
+            poll_shard(shard);
+        }
+
+        // Out of local work: steal until a full sweep finds every deque empty.
+        // No shards are pushed during a tick, so empty stays empty.
+        const size_t n = num_threads();
+        bool found_work = true;
+        while (found_work) {
+            found_work = false;
+            for (size_t k = 1; k < n; ++k) {
+                auto& victim = *deques[(self + k) % n];
+                size_t shard;
+                while ((shard = victim.steal()) != psm_work_stealing_deque_t::EMPTY) {
+                    found_work = true;
+                    if (shard != psm_work_stealing_deque_t::LOST) {
+                        poll_shard(shard);
+                    }
+                }
+            }
+        }
+    }
+
+    void poll_shard(size_t shard) {
+        const size_t begin = shard * shard_size;
+        const size_t end   = std::min(begin + shard_size, num_machines);
+        fleet.poll(begin, end);
+        if (shard_polled) {
+            shard_polled(shard, begin, end);
+        }
+    }
+
+    // Data members
+
+    fleet_t&     fleet;
+    const size_t shard_size;
+    size_t       num_machines = 0; // fleet.size() when it was last cut into shards
+    size_t       num_shards   = 0;
+
+    std::vector<std::unique_ptr<psm_work_stealing_deque_t>> deques;
+    std::vector<std::thread>                                threads;
+    std::function<void(size_t, size_t, size_t)>             shard_polled;
+
+    alignas(64) std::atomic<uint64_t> epoch{0};
+    alignas(64) std::atomic<size_t>   num_busy_workers{0};
+    std::atomic<bool>                 stopping{false};
+};
@@ -0,0 +1,137 @@
+#include "psm_state_export.h"
+#include "stoplight_sm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Shows the states a psm_state_exporter_t<stoplight_sm_t> is publishing:
+// how many members are in each state and their entries seen in all, plus,
+// with -m, each of the given members' state, time in state and entries seen.
+// Entries seen are the state entries a publish happened to see, not
+// transitions: a member that entered several states between two publishes
+// counts one. Members of shards that stayed mid-publish too long to copy show
+// as busy if the shard was published since the last sample, as when the
+// fleet is only slow, and as stale if it wasn't, as when the fleet died while
+// publishing.
+//
+// Usage: state_monitor [-i interval_ms] [-n num_samples] [-m first[:count]] segment
+//
+// Takes one sample unless -n says otherwise, -i apart (1000 ms by default).
+// Sampling only reads the mapping; the only syscalls between samples are the
+// sleep and yields while waiting on a shard that's mid-publish.
+
+static int usage() {
+    std::cerr << "usage: state_monitor [-i interval_ms] [-n num_samples] [-m first[:count]] segment\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    size_t      interval_ms = 1000;
+    size_t      num_samples = 1;
+    size_t      first       = 0;
+    size_t      count       = 0;
+    const char *segment     = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            interval_ms = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num_samples = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            char *colon;
+            first = strtoul(argv[++i], &colon, 0);
+            count = *colon == ':' ? strtoul(colon + 1, nullptr, 0) : 1;
+        }
+        else if (argv[i][0] != '-' && !segment) {
+            segment = argv[i];
+        }
+        else {
+            return usage();
+        }
+    }
+    if (!segment) {
+        return usage();
+    }
+
+    psm_state_export_reader_t reader;
+    if (!reader.open(segment)) {
+        perror(segment);
+        return 1;
+    }
+
+    size_t num_states = 0;
+    while (stoplight_sm_t::state_name(num_states)) {
+        ++num_states;
+    }
+
+    std::vector<uint32_t>             published_ms(reader.num_shards());
+    std::vector<psm_shard_read_t>     reads(reader.num_shards());
+    std::vector<psm_exported_state_t> members(reader.size());
+
+    for (size_t sample = 0; sample < num_samples; ++sample) {
+        if (sample > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+
+        size_t num_retries = 0;
+        size_t num_busy    = 0;
+        size_t num_stale   = 0;
+        for (size_t s = 0; s < reader.num_shards(); ++s) {
+            reads[s] = reader.read_shard(s, &members[s * reader.shard_size()], published_ms[s], &num_retries);
+            num_busy  += reads[s] == psm_shard_read_t::busy;
+            num_stale += reads[s] == psm_shard_read_t::stale;
+        }
+
+        // After the states, rows for unknown states and for members of busy and stale shards.
+        const size_t UNKNOWN = num_states, BUSY = num_states + 1, STALE = num_states + 2;
+        std::vector<size_t> in_state(num_states + 3);
+        std::vector<size_t> entries (num_states + 3);
+        for (size_t i = 0; i < members.size(); ++i) {
+            const psm_shard_read_t read  = reads[i / reader.shard_size()];
+            const size_t           state = read == psm_shard_read_t::busy  ? BUSY
+                                         : read == psm_shard_read_t::stale ? STALE
+                                         : std::min<size_t>(members[i].state, UNKNOWN);
+            ++in_state[state];
+            entries[state] += state >= BUSY ? 0 : members[i].num_entries_seen;
+        }
+
+        std::cout << reader.size() << " machines in " << reader.num_shards() << " shards, " << num_retries << " retries, "
+                  << num_busy << " busy, " << num_stale << " stale\n";
+        std::cout << std::left << std::setw(16) << "state" << std::right << std::setw(12) << "machines" << std::setw(14) << "entries seen" << "\n";
+        for (size_t state = 0; state <= STALE; ++state) {
+            if (in_state[state]) {
+                std::cout
+                    << std::left  << std::setw(16) << (state < num_states ? stoplight_sm_t::state_name(state)
+                                                       : state == UNKNOWN ? "(unknown)" : state == BUSY ? "(busy)" : "(stale)")
+                    << std::right << std::setw(12) << in_state[state]
+                    << std::setw(14) << entries[state] << "\n";
+            }
+        }
+        std::cout << "(entries seen: state entries a publish happened to see; entries between two publishes count as one)\n";
+
+        for (size_t i = first; i < std::min(first + count, reader.size()); ++i) {
+            const size_t                shard  = i / reader.shard_size();
+            const psm_exported_state_t& member = members[i];
+            const char *name = stoplight_sm_t::state_name(member.state);
+            std::cout << "machine " << std::setw(7) << i << ": ";
+            if (reads[shard] != psm_shard_read_t::ok) {
+                std::cout << (reads[shard] == psm_shard_read_t::busy ? "(busy)\n" : "(stale)\n");
+                continue;
+            }
+            std::cout
+                << std::left  << std::setw(16) << (name ? name : "(unknown)")
+                << std::right << std::setw(8) << published_ms[shard] - member.state_entered_ms << " ms in state, "
+                << member.num_entries_seen << " entries seen\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+#pragma once
+
+#include "mcu_mocks.h"
+#include "polling_state_machine.h"
+#include "psm_machine.h"
+
+#include "X_macro_helpers.h"
+
+#ifdef STOPLIGHT_PROFILE
+#ifdef PSM_EMBEDDED
+#error "psm_state_profiler_t reports through iostreams; profile a hosted build"
+#endif
+#include "psm_profile.h"
+#endif
+
+#ifndef PSM_EMBEDDED
+#include <ostream>
+#endif
+
+// Built with -DSTOPLIGHT_DISPATCH_PROFILE='"header"', a header of dispatch
+// hints dispatch_gen made from a profile of the machine (see psm_dispatch.h
+// and `make dispatch_bench`).
+#ifdef STOPLIGHT_DISPATCH_PROFILE
+#include "psm_dispatch.h"
+#include STOPLIGHT_DISPATCH_PROFILE
+#define STOPLIGHT_CASE(STATE) PSM_PROFILED_CASE(STOPLIGHT, STATE)
+#define STOPLIGHT_DISPATCH_HOT_STATES PSM_DISPATCH_HOT_STATES(STOPLIGHT)
+#else
+#define STOPLIGHT_CASE(STATE) case state_t::STATE
+#define STOPLIGHT_DISPATCH_HOT_STATES
+#define STOPLIGHT_TRANSITIONS_RARE 0
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Stoplight State Machine
+
+// Passes through the actions one poll may make before finishing a chain of
+// transitions on the next tick (see PSM_DECLARE_TRANSITION_BUDGET()); 0 for
+// no limit.
+#ifndef STOPLIGHT_MAX_PASSES_PER_POLL
+#define STOPLIGHT_MAX_PASSES_PER_POLL 4
+#endif
+
+#define FOREACH_STOPLIGHT_STATE_MACHINE_STATE(X) \
+    X(Red)                                       \
+    X(Yellow)                                    \
+    X(Green)                                     \
+    X(Errored)                                   \
+    X(Faulted)                                   \
+
+#define LOG_STATE(kind, from_state, to_state) log_event((kind), (size_t)(to_state), (size_t)(from_state))
+
+enum stoplight_trace_kind_t : uint8_t {
+    STOPLIGHT_TRACE_ERROR_EVENT = MCU_TRACE_FIRST_USER_KIND,
+    STOPLIGHT_TRACE_ERROR_CLEARED_EVENT,
+    STOPLIGHT_TRACE_HEADING_TO_ERRORED, // to: rejected requested next_state
+};
+
+enum stoplight_input_t : uint8_t {
+    STOPLIGHT_INPUT_ERROR_EVENT = MCU_FIRST_USER_INPUT,
+    STOPLIGHT_INPUT_ERROR_CLEARED_EVENT,
+};
+
+class stoplight_sm_t : public psm_machine_t<stoplight_sm_t> {
+public:
+
+    void handle_error_event() {
+        log_event(STOPLIGHT_TRACE_ERROR_EVENT, 0);
+        record_input(STOPLIGHT_INPUT_ERROR_EVENT, true);
+        set_next_state(state_t::Errored);
+    }
+
+    void handle_error_cleared_event() {
+        log_event(STOPLIGHT_TRACE_ERROR_CLEARED_EVENT, 0);
+        record_input(STOPLIGHT_INPUT_ERROR_CLEARED_EVENT, true);
+        set_next_state(state_t::Red);
+    }
+
+    enum class event_t : uint8_t {
+        error,
+        error_cleared,
+    };
+
+    void handle_event(event_t event) {
+        switch (event) {
+            case event_t::error:         handle_error_event();         break;
+            case event_t::error_cleared: handle_error_cleared_event(); break;
+        }
+    }
+
+    // Applies an input change recorded from a stoplight_sm_t or the mocks.
+    void apply_input(const psm_input_record_t& record) {
+        if (apply_mcu_input(record)) {
+            return;
+        }
+
+        switch (record.input) {
+            case STOPLIGHT_INPUT_ERROR_EVENT:         handle_error_event();         break;
+            case STOPLIGHT_INPUT_ERROR_CLEARED_EVENT: handle_error_cleared_event(); break;
+        }
+    }
+
+    friend bool operator==(const stoplight_sm_t&, const stoplight_sm_t&) = default;
+
+    [[nodiscard]] size_t elapsed_ms() const { // Time in the current state
+        return psm_elapsed_ms32(now_ms, state_entered_ms);
+    }
+
+    // Formats the line for any record logged by a stoplight_sm_t or the mocks.
+    static void emit_log_line(const psm_trace_record_t& record, mcu_log_line_t& line) {
+        if (emit_mcu_log_line(record, line)) {
+            return;
+        }
+
+        emit_log_prefix(line, record.ms);
+        switch (record.kind) {
+            case PSM_TRACE_ENTERED:                   line << "state: ";                emit_name(line, state_name(record.to), record.to); line << "\n"; break;
+            case PSM_TRACE_REQUESTED:                 line << "requested_next_state: "; emit_name(line, state_name(record.to), record.to); line << "\n"; break;
+            case PSM_TRACE_REJECTED:                  line << "rejected_transition: ";  emit_name(line, state_name(record.to), record.to); line << "\n"; break;
+            case STOPLIGHT_TRACE_ERROR_EVENT:         line << "handle_error_event()\n";                                   break;
+            case STOPLIGHT_TRACE_ERROR_CLEARED_EVENT: line << "handle_error_cleared_event()\n";                           break;
+            case STOPLIGHT_TRACE_HEADING_TO_ERRORED:  line << "set_next_state(): rejected transition while heading to Errored state\n"; break;
+            default:                                  line << "unknown trace record kind " << (unsigned)record.kind << "\n"; break;
+        }
+    }
+
+#ifndef PSM_EMBEDDED
+    static void emit_log_line(const psm_trace_record_t& record, std::ostream& out) {
+        mcu_log_line_t line;
+        emit_log_line(record, line);
+        out.write(line.data(), line.size());
+    }
+#endif
+
+    // Call 1/ms, or at least by the returned time and whenever an event or
+    // input has changed; polls in between would do nothing. Classes derived
+    // from this can declare a coarser period for psm_rate_groups_t. Writes out
+    // the lamps the poll changed before returning.
+    ms_t poll() {
+        ms_t       wake_ms      = now_ms + 1; // States that wait on the clock push this out
+        const auto lamps_before = psm_outputs;
+
+#ifdef STOPLIGHT_USE_PSM_DO_ACTIONS // The GNU macro engine, for `make codegen_test`
+        PSM_DO_ACTIONS(*this) {
+            actions(psm_prev_state, psm_state, psm_next_state, wake_ms);
+        }
+#else
+        if (!do_actions(wake_ms)) {
+            wake_ms = now_ms + 1; // Out of budget, finish the transition next tick
+        }
+#endif
+
+        psm_outputs.flush_since(lamps_before, write_outputs);
+        return wake_ms;
+    }
+
+    // Writes out the lamps in   changed   as   image   has them; for
+    // psm_fleet_t::write_outputs().
+    static void write_outputs(uint8_t image, uint8_t changed) {
+        write_lamps(image, changed);
+    }
+
+    // Handles the events other threads or IRQs have posted to   mailbox   (see
+    // psm_mailbox.h), then polls.
+    template <typename mailbox_t>
+    ms_t poll(mailbox_t& mailbox) {
+        event_t event;
+        while (mailbox.try_pop(event)) {
+            handle_event(event);
+        }
+        return poll();
+    }
+
+    // For psm_fleet_t's guard pre-pass: a bit per state in which the shared
+    // guards would change next_state with the inputs as they are now.
+    static uint32_t guarded_states() {
+        uint32_t guarded = 0;
+        for (size_t s = 0; s <= (size_t)state_t::M_LAST_DECL_IN(FOREACH_STOPLIGHT_STATE_MACHINE_STATE); ++s) {
+            guarded |= (uint32_t)(shared_guards((state_t)s) != (state_t)s) << s;
+        }
+        return guarded;
+    }
+
+    static ms_t now() {
+        return now_ms;
+    }
+
+    PSM_DECLARE_MACHINE_TYPE("stoplight_sm_t", FOREACH_STOPLIGHT_STATE_MACHINE_STATE)
+
+    // The name of state index   i   , as exported by psm_state_exporter_t, or
+    // nullptr if there's no such state.
+    static const char *state_name(size_t i) {
+        return i <= (size_t)state_t::M_LAST_DECL_IN(FOREACH_STOPLIGHT_STATE_MACHINE_STATE) ? state_names[i] : nullptr;
+    }
+
+private:
+
+    enum class state_t : PSM_STATE_INDEX_TYPE(FOREACH_STOPLIGHT_STATE_MACHINE_STATE) {
+        unset,
+        FOREACH_STOPLIGHT_STATE_MACHINE_STATE(DECLARE_NAME)
+    };
+
+#ifdef STOPLIGHT_PROFILE
+    using profiler_t = psm_state_profiler_t<state_t, M_NUM_DECLS_IN(FOREACH_STOPLIGHT_STATE_MACHINE_STATE) + 1>;
+
+    PSM_DECLARE_PROFILER(profiler_t)
+
+public:
+
+    // Call for each machine before export_profile(), so time in the states
+    // they haven't left yet is counted too.
+    void profile_still_in_state() const {
+        profiler_t::on_still_in_state(state, (uint32_t)elapsed_ms());
+    }
+
+    static void export_profile(std::ostream& out) {
+        profiler_t::export_to(out, state_names);
+    }
+
+    // For dispatch_gen.
+    static void export_dispatch_profile(std::ostream& out) {
+        profiler_t::export_dispatch_profile(out, state_names);
+    }
+
+private:
+#endif
+
+    static const char *const state_names[];
+
+    friend psm_machine_t;
+
+    void actions(PSM_ACTIONS_PARAMS, ms_t& wake_ms) {
+
+        // Logic common to all states.
+        IF_ENTRY {
+            LOG_STATE(PSM_TRACE_ENTERED, psm_prev_state, state);
+            state_entered_ms = (psm_ms32_t)now_ms;
+            wake_ms = now_ms + 1;
+        }
+        IF_DO {
+            const state_t guarded_next_state = shared_guards(state);
+            if (guarded_next_state != state) {
+                set_next_state(guarded_next_state);
+            }
+        }
+
+        STOPLIGHT_DISPATCH_HOT_STATES
+        switch (state) {
+            STOPLIGHT_CASE(unset):
+                // ...initialize things here...
+                set_next_state(state_t::Red);
+                break;
+
+            STOPLIGHT_CASE(Red):
+                IF_ENTRY {
+                     set_light(mcu_lamp_t::Red, true);
+                }
+                IF_DO {
+                    if (elapsed_ms() > 5000) {
+                        set_next_state(state_t::Green);
+                    }
+                    else {
+                        wake_ms = now_ms + 5001 - elapsed_ms();
+                    }
+                }
+                IF_EXIT {
+                     set_light(mcu_lamp_t::Red, false);
+                }
+                break;
+
+            STOPLIGHT_CASE(Yellow):
+                IF_ENTRY {
+                     set_light(mcu_lamp_t::Yellow, true);
+                }
+                IF_DO {
+                    if (elapsed_ms() > 1000) {
+                        set_next_state(state_t::Red);
+                    }
+                    else {
+                        wake_ms = now_ms + 1001 - elapsed_ms();
+                    }
+                }
+                IF_EXIT {
+                     set_light(mcu_lamp_t::Yellow, false);
+                }
+                break;
+
+            STOPLIGHT_CASE(Green):
+                IF_ENTRY {
+                     set_light(mcu_lamp_t::Green, true);
+                }
+                IF_DO {
+                    if (elapsed_ms() > 5000) {
+                        set_next_state(state_t::Yellow);
+                    }
+                    else {
+                        wake_ms = now_ms + 5001 - elapsed_ms();
+                    }
+                }
+                IF_EXIT {
+                     set_light(mcu_lamp_t::Green, false);
+                }
+                break;
+
+            STOPLIGHT_CASE(Errored):
+                IF_ENTRY {
+                     set_light(mcu_lamp_t::Red, true);
+                }
+                IF_DO {
+                    set_light(mcu_lamp_t::Red, (elapsed_ms() % 2000) >= 1000);
+                    wake_ms = now_ms + 1000 - elapsed_ms() % 1000;
+                }
+                IF_EXIT {
+                    set_light(mcu_lamp_t::Red, false);
+                }
+                break;
+
+            STOPLIGHT_CASE(Faulted):
+                IF_ENTRY {
+                     set_light(mcu_lamp_t::Red, true);
+                }
+                IF_DO {
+                    set_light(mcu_lamp_t::Red, (elapsed_ms() % 2000) >= 1000);
+                    wake_ms = now_ms + 1000 - elapsed_ms() % 1000;
+                }
+                IF_EXIT {
+                    reject_transition(); // Don't allow exit from state, require power cycle
+                }
+                break;
+        }
+    }
+
+    // The state the guards all states share call for from   state   , or
+    // state   itself if none do.
+    static state_t shared_guards(state_t state) {
+#if STOPLIGHT_TRANSITIONS_RARE // Profiled: almost every pass finds no hazard, so check for that first
+        if (!some_hw_error_exists && !emergency_vehicle_detected) [[likely]] {
+            return state;
+        }
+#endif
+             if (some_hw_error_exists                                  ) { return state_t::Faulted; }
+        else if (state < state_t::Faulted && some_hw_error_exists      ) { return state_t::Errored; }
+        else if (state < state_t::Errored && emergency_vehicle_detected) { return state_t::Red;     }
+        return state;
+    }
+
+    void set_light(mcu_lamp_t lamp, bool on) {
+        psm_outputs.set(lamp, on);
+    }
+
+    void set_next_state(state_t requested_next_state) {
+        if (requested_next_state != next_state) {
+            LOG_STATE(PSM_TRACE_REQUESTED, state, requested_next_state);
+        }
+
+        if (state != state_t::Errored && next_state == state_t::Errored) {
+            LOG_STATE(STOPLIGHT_TRACE_HEADING_TO_ERRORED, state, requested_next_state);
+            return; // ignore, next_state_ and go to error state even if a later call tries to go to a normal state.
+        }
+
+        next_state = requested_next_state;
+    }
+
+    void reject_transition() { // Can be called in IF_DO or IF_EXIT (not IF_ENTRY; by then it's too late)
+        if (next_state != state) {
+            LOG_STATE(PSM_TRACE_REJECTED, state, next_state);
+            next_state = state;
+        }
+    }
+
+    template <typename> friend class psm_fleet_t; // Polls instances stored as arrays
+
+    // Data members
+
+    // 8 bytes, the lamps' image taking what would be padding. Time in state
+    // wraps after ~49.7 days, which only shifts the phase of a long-Faulted
+    // machine's blinking once per wrap.
+#if STOPLIGHT_MAX_PASSES_PER_POLL
+    PSM_DECLARE_TRANSITION_BUDGET(state_t, STOPLIGHT_MAX_PASSES_PER_POLL)
+#endif
+    PSM_DECLARE_OUTPUTS(mcu_lamps_t)
+    PSM_DECLARE_PACKED_STATE_MACHINE_FIELDS(state_t)
+};
+
+static_assert(sizeof(stoplight_sm_t) == 8);
+
+inline const char *const stoplight_sm_t::state_names[] = {
+    "unset",
+    FOREACH_STOPLIGHT_STATE_MACHINE_STATE(DECLARE_STRING)
+};
@@ -1,271 +1,210 @@
-#include "polling_state_machine.h"
+#include "psm_clock.h"
+#include "stoplight_sm.h"
 
-#include "X_macro_helpers.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-#include <chrono>
-#include <iomanip>
+#ifdef PSM_EMBEDDED
+#include "psm_no_heap.h"
+#else
 #include <iostream>
-#include <cstring>
-#include <thread>
+#endif
 
 // This file is a mock of a typical bare-metal MCU main.c.
+//
+// Usage: stoplights [-f] [-c clock] [-d duration_ms] [-r input_file] [trace_file]
+//
+// Prints the log as text, or with trace_file, writes the raw trace records
+// there for trace_decode. Built with -DSTOPLIGHT_PROFILE (make
+// stoplights_profiled), it also writes per-state profile counters to stderr
+// at exit.
+//
+// -c picks where now_ms comes from (see psm_clock.h): virtual, the default,
+// simulates time as fast as the machine can be polled; steady, coarse and
+// tsc run in real time. Either way the clock is read once per tick.
+//
+// -d runs for duration_ms instead of 30 s.
+//
+// -r records every input change and event delivered to sm in input_file, for
+// input_replay.
+//
+// -f fast-forwards the clock: instead of ticking every ms, now_ms jumps
+// straight to the next scenario event or the time sm asked to be polled by,
+// whichever is first. Every poll that could do anything still happens at the
+// same now_ms, so the log is identical to the tick-by-tick run's; weeks of
+// simulated time take seconds. Virtual clock only.
+//
+// Built with -DPSM_EMBEDDED (make stoplights_embedded), it formats the log
+// into a fixed buffer and writes it with mcu_console_write(), and aborts if
+// anything uses the heap (see psm_no_heap.h). Only the virtual and coarse
+// clocks are available, and there are no files to write trace records or
+// input recordings to.
 
 ////////////////////////////////////////////////////////////////////////////////
-// Mocks
-
-// Timekeeping typical of a tiny bare metal MCU
-
-typedef size_t ms_t;
-
-static ms_t now_ms;
-
-[[nodiscard]] static size_t elapsed_ms(ms_t ms) {
-    return now_ms > ms
-        ? (size_t)(now_ms - ms)
-        : 0u;
-}
-
-// Logging
-
-static void emit_log_prefix() {
-    std::cout << std::right; // Restore default
-    std::cout << std::setw(5) << now_ms << " ";
-}
-
-#define LOG(symbol) [&] () {                       \
-    emit_log_prefix();                             \
-    std::cout << #symbol ": " << (symbol) << "\n"; \
-}()
-
-// Output controller for the actual lamps
-
-static void set_light(const char *name, bool on) {
-    static char prev_name[10];
-    static bool prev_on = false;
-    if (strcmp(name, prev_name) != 0 || on != prev_on) {
-        emit_log_prefix();
-
-        std::cout
-            << "set_light(): "
-            << name
-            << " "
-            << (on ? "on" : "off" )
-            << "\n";
+// Log output, off the polling path
 
-        strncpy(prev_name, name, sizeof(prev_name) - 1);
-        prev_on = on;
+static void drain_log(FILE *trace_file) {
+    psm_trace_record_t record;
+    while (trace.try_pop(record)) {
+        if (trace_file) {
+            fwrite(&record, sizeof(record), 1, trace_file);
+        }
+        else {
+#ifdef PSM_EMBEDDED
+            mcu_log_line_t line;
+            stoplight_sm_t::emit_log_line(record, line);
+            mcu_console_write(line);
+#else
+            stoplight_sm_t::emit_log_line(record, std::cout);
+#endif
+        }
     }
 }
 
-// Unusual Conditions
-
-static bool some_hw_error_exists;
-
-static void simulate_hw_error(bool some_hw_error_exists_) {
-    if (some_hw_error_exists != some_hw_error_exists_) {
-        some_hw_error_exists = some_hw_error_exists_;
-        LOG(some_hw_error_exists);
-    }
+static void report([[maybe_unused]] const stoplight_sm_t& sm) {
+#ifdef STOPLIGHT_PROFILE
+    sm.profile_still_in_state();
+    stoplight_sm_t::export_profile(std::cerr);
+#endif
 }
 
-static bool emergency_vehicle_detected;
-
-static void simulate_emergency_vehicle_detected(bool emergency_vehicle_detected_) {
-    if (emergency_vehicle_detected != emergency_vehicle_detected_) {
-        emergency_vehicle_detected = emergency_vehicle_detected_;
-        LOG(emergency_vehicle_detected);
+////////////////////////////////////////////////////////////////////////////////
+// Scenario: events to deliver to sm, by elapsed_ms(0)
+
+#define FOREACH_SCENARIO_EVENT(X) \
+    X(10000, sm.handle_error_event()                    ) \
+    X(11000, simulate_emergency_vehicle_detected(false) ) \
+    X(15000, sm.handle_error_cleared_event()            ) \
+    X(16000, simulate_hw_error(true)                    ) \
+    X(17000, sm.handle_error_cleared_event()            ) \
+    X(18000, simulate_hw_error(false)                   ) \
+    X(19000, sm.handle_error_cleared_event()            ) \
+    X(80000, simulate_emergency_vehicle_detected(true)  ) \
+
+// Events are delivered at the first tick at or after their time, so none are
+// missed when a real clock skips a ms.
+#define DECLARE_EVENT_DELIVERY(at_ms, action) if (at_ms >= from_ms && at_ms <= now_ms) { action; delivered = true; }
+#define DECLARE_EVENT_MS(      at_ms, action) at_ms,
+
+static constexpr ms_t scenario_event_ms[] = { FOREACH_SCENARIO_EVENT(DECLARE_EVENT_MS) };
+
+// The first scenario event after   ms  , or SIZE_MAX if none.
+static ms_t next_event_ms(ms_t ms) {
+    ms_t next = SIZE_MAX;
+    for (ms_t event_ms : scenario_event_ms) {
+        if (event_ms > ms && event_ms < next) {
+            next = event_ms;
+        }
     }
+    return next;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Stoplight State Machine
-
-#define FOREACH_STOPLIGHT_STATE_MACHINE_STATE(X) \
-    X(Red)                                       \
-    X(Yellow)                                    \
-    X(Green)                                     \
-    X(Errored)                                   \
-    X(Faulted)                                   \
-
-#define LOG_STATE(state_symbol) [&] () {                                                            \
-    emit_log_prefix();                                                                              \
-    std::cout << #state_symbol ": " << stoplight_sm_t::state_names[(size_t)(state_symbol)] << "\n"; \
-}()
-
-class stoplight_sm_t {
-public:
-
-    void handle_error_event() {
-        emit_log_prefix();
-        std::cout << "handle_error_event()\n";
-        set_next_state(state_t::Errored);
-    }
-
-    void handle_error_cleared_event() {
-        emit_log_prefix();
-        std::cout << "handle_error_cleared_event()\n";
-        set_next_state(state_t::Red);
-    }
-
-    void poll() { // Call 1/ms
-        PSM_DO_ACTIONS(*this) {
-
-            // Logic common to all states.
-            IF_ENTRY {
-                LOG_STATE(state);
-                state_entered_ms = now_ms;
-            }
-            IF_DO {
-                     if (some_hw_error_exists                                  ) { set_next_state(state_t::Faulted); }
-                else if (state < state_t::Faulted && some_hw_error_exists      ) { set_next_state(state_t::Errored); }
-                else if (state < state_t::Errored && emergency_vehicle_detected) { set_next_state(state_t::Red    ); }
-            }
-
-            switch (state) {
-                case state_t::unset:
-                    // ...initialize things here...
-                    set_next_state(state_t::Red);
-                    break;
-
-                case state_t::Red:
-                    IF_ENTRY {
-                         set_light("Red", true);
-                    }
-                    IF_DO {
-                        if (elapsed_ms() > 5000) {
-                            set_next_state(state_t::Green);
-                        }
-                    }
-                    IF_EXIT {
-                         set_light("Red", false);
-                    }
-                    break;
-
-                case state_t::Yellow:
-                    IF_ENTRY {
-                         set_light("Yellow", true);
-                    }
-                    IF_DO {
-                        if (elapsed_ms() > 1000) {
-                            set_next_state(state_t::Red);
-                        }
-                    }
-                    IF_EXIT {
-                         set_light("Yellow", false);
-                    }
-                    break;
-
-                case state_t::Green:
-                    IF_ENTRY {
-                         set_light("Green", true);
-                    }
-                    IF_DO {
-                        if (elapsed_ms() > 5000) {
-                            set_next_state(state_t::Yellow);
-                        }
-                    }
-                    IF_EXIT {
-                         set_light("Green", false);
-                    }
-                    break;
+// Mock a typical embedded system main loop or timer tick IRQ handler
 
-                case state_t::Errored:
-                    IF_ENTRY {
-                         set_light("Red", true);
-                    }
-                    IF_DO {
-                        set_light("Red", (elapsed_ms() % 2000) >= 1000);
-                    }
-                    IF_EXIT {
-                        set_light("Red", false);
-                    }
-                    break;
+template <typename clock_t>
+static int run(clock_t& clock, bool fast_forward, ms_t duration_ms, FILE *trace_file) {
+    stoplight_sm_t sm;
+    ms_t           sm_wake_ms = 0;
+    ms_t           from_ms    = 0; // Scenario events before this were delivered
+    const uint64_t start_ms   = clock.read_ms();
 
-                case state_t::Faulted:
-                    IF_ENTRY {
-                         set_light("Red", true);
-                    }
-                    IF_DO {
-                        set_light("Red", (elapsed_ms() % 2000) >= 1000);
-                    }
-                    IF_EXIT {
-                        reject_transition(); // Don't allow exit from state, require power cycle
-                    }
-                    break;
+    while (true) {
+        now_ms = clock.read_ms() - start_ms; // The one read this tick; everything else reads now_ms
+
+        if (elapsed_ms(0) >= duration_ms) {
+            drain_log(trace_file);
+            report(sm);
+#ifndef PSM_EMBEDDED
+            if (input_recorder.is_open() && !input_recorder.close(now_ms)) {
+                return 1;
             }
+#endif
+            return 0;
         }
-    }
 
-private:
+        bool delivered = false; // Deliver some events to sm
+        FOREACH_SCENARIO_EVENT(DECLARE_EVENT_DELIVERY)
+        from_ms = now_ms + 1;
 
-    enum class state_t {
-        unset,
-        FOREACH_STOPLIGHT_STATE_MACHINE_STATE(DECLARE_NAME)
-    };
-
-    static const char *const state_names[];
+        if (delivered || now_ms >= sm_wake_ms) { // Let sm sleep while waiting on the clock
+            sm_wake_ms = sm.poll();
+        }
 
-    [[nodiscard]] size_t elapsed_ms() {
-        return ::elapsed_ms(state_entered_ms);
-    }
+        drain_log(trace_file);
 
-    void set_next_state(state_t requested_next_state) {
-        if (requested_next_state != next_state) {
-            LOG_STATE(requested_next_state);
+        if (fast_forward) {
+            psm_wait_until(clock, start_ms + std::max(now_ms + 1, std::min({ sm_wake_ms, next_event_ms(now_ms), duration_ms })));
         }
-
-        if (state != state_t::Errored && next_state == state_t::Errored) {
-            emit_log_prefix();
-            std::cout << "set_next_state(): rejected transition while heading to Errored state\n";
-            return; // ignore, next_state_ and go to error state even if a later call tries to go to a normal state.
+        else {
+            psm_wait_until(clock, start_ms + now_ms + 1);
         }
-
-        next_state = requested_next_state;
     }
+}
 
-    void reject_transition() { // Can be called in IF_DO or IF_EXIT (not IF_ENTRY; by then it's too late)
-        if (next_state != state) {
-            auto& rejected_transition = next_state;
-            LOG_STATE(rejected_transition);
-            next_state = state;
+int main(int argc, char **argv) {
+    bool        fast_forward = false;
+    const char *clock_name   = "virtual";
+    ms_t        duration_ms  = 30000;
+    FILE       *trace_file   = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-f")) {
+            fast_forward = true;
         }
-    }
-
-    // Data members
-
-    PSM_DECLARE_STATE_MACHINE_FIELDS(state_t)
-
-    size_t state_entered_ms;
-};
-
-const char *const stoplight_sm_t::state_names[] = {
-    "unset",
-    FOREACH_STOPLIGHT_STATE_MACHINE_STATE(DECLARE_STRING)
-};
-
-////////////////////////////////////////////////////////////////////////////////
-// Mock a typical embedded system main loop or timer tick IRQ handler
-
-int main() {
-    stoplight_sm_t sm;
-
-    while (true) {
-        switch (elapsed_ms(0)) { // Deliver some events to sm
-            case 80000: simulate_emergency_vehicle_detected(true);  break;
-            case 10000: sm.handle_error_event();                    break;
-            case 11000: simulate_emergency_vehicle_detected(false); break;
-            case 15000: sm.handle_error_cleared_event();            break;
-            case 16000: simulate_hw_error(true);                    break;
-            case 17000: sm.handle_error_cleared_event();            break;
-            case 18000: simulate_hw_error(false);                   break;
-            case 19000: sm.handle_error_cleared_event();            break;
-            case 30000: return 0;                                   break;
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            clock_name = argv[++i];
         }
-
-        sm.poll();
-
-        // Uncomment for verisimilitue: std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        ++now_ms;
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            duration_ms = strtoull(argv[++i], nullptr, 10);
+        }
+#ifdef PSM_EMBEDDED
+        else {
+            fprintf(stderr, "%s: no files in an embedded build\n", argv[i]);
+            return 1;
+        }
+#else
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            if (!input_recorder.open(argv[++i])) {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else {
+            trace_file = fopen(argv[i], "wb");
+            if (!trace_file) {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+#endif
     }
 
+    if (!strcmp(clock_name, "virtual")) {
+        psm_virtual_clock_t clock;
+        return run(clock, fast_forward, duration_ms, trace_file);
+    }
+    if (fast_forward) {
+        fprintf(stderr, "-f needs the virtual clock\n");
+        return 1;
+    }
+#ifndef PSM_EMBEDDED
+    if (!strcmp(clock_name, "steady")) {
+        psm_steady_clock_t clock;
+        return run(clock, false, duration_ms, trace_file);
+    }
+#endif
+    if (!strcmp(clock_name, "coarse")) {
+        psm_coarse_clock_t clock;
+        return run(clock, false, duration_ms, trace_file);
+    }
+#if PSM_HAVE_TSC_CLOCK
+    if (!strcmp(clock_name, "tsc")) {
+        psm_tsc_clock_t clock;
+        return run(clock, false, duration_ms, trace_file);
+    }
+#endif
+    fprintf(stderr, "unknown clock %s\n", clock_name);
+    return 1;
 }
@@ -0,0 +1,40 @@
+#include "stoplight_sm.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// Decodes a trace file written by   stoplights trace_file   (or any dump of
+// psm_trace_record_t from stoplight_sm_t fleets) into the same text stoplights
+// prints.
+//
+// Usage: trace_decode [-m] [trace_file]
+//
+// Reads stdin if no trace_file is given. -m prefixes each line with the
+// record's machine index, for traces from fleets.
+
+int main(int argc, char **argv) {
+    bool  show_machine = false;
+    FILE *in           = stdin;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-m") == 0) {
+            show_machine = true;
+        }
+        else if (!(in = fopen(argv[i], "rb"))) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    psm_trace_record_t record;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (show_machine) {
+            std::cout << std::setw(7) << record.machine << " ";
+        }
+        stoplight_sm_t::emit_log_line(record, std::cout);
+    }
+
+    return ferror(in) ? 1 : 0;
+}